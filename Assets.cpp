@@ -0,0 +1,95 @@
+#define STB_IMAGE_IMPLEMENTATION
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "Assets.hpp"
+
+void loadObj(Mesh& mesh, const std::string& path) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+    std::string warn;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), nullptr)) {
+        throw std::runtime_error(err);
+    }
+    std::vector<Vertex> corners;
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            Vertex vertex{};
+            vertex.x = floatToHalf(attrib.vertices[3 * index.vertex_index + 0]);
+            vertex.y = floatToHalf(attrib.vertices[3 * index.vertex_index + 1]);
+            vertex.z = floatToHalf(attrib.vertices[3 * index.vertex_index + 2]);
+            vertex.tx = floatToHalf(attrib.texcoords[2 * index.texcoord_index + 0]);
+            vertex.ty = floatToHalf(1.0f - attrib.texcoords[2 * index.texcoord_index + 1]);
+            glm::vec3 normal = {
+                attrib.normals[3 * index.normal_index + 0],
+                attrib.normals[3 * index.normal_index + 1],
+                attrib.normals[3 * index.normal_index + 2],
+            };
+            normal = glm::normalize(normal);
+            // input float is [-1.0, 1.0], we need to convert it to [0, 255] to fit into uint8_t
+            vertex.nx = uint8_t((normal.x*0.5f+0.5f)*255.0f);
+            vertex.ny = uint8_t((normal.y*0.5f+0.5f)*255.0f);
+            vertex.nz = uint8_t((normal.z*0.5f+0.5f)*255.0f);
+            corners.push_back(vertex);
+        }
+    }
+    weldVertices(mesh, corners);
+}
+void weldVertices(Mesh& mesh, const std::vector<Vertex>& corners) {
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    uniqueVertices.reserve(corners.size());
+    mesh.indices.reserve(mesh.indices.size() + corners.size());
+    for (const Vertex& vertex: corners) {
+        // a single lookup, emplace leaves the existing index alone if the vertex was seen before
+        auto [it, inserted] = uniqueVertices.emplace(vertex, static_cast<uint32_t>(mesh.vertices.size()));
+        if (inserted) mesh.vertices.push_back(vertex);
+        mesh.indices.push_back(it->second);
+    }
+}
+void splitVertexStreams(Mesh& mesh, uint32_t first, uint32_t last) {
+    mesh.positions.resize(mesh.vertices.size());
+    mesh.attributes.resize(mesh.vertices.size());
+    for (uint32_t i=first; i<last; i++) {
+        const Vertex& v = mesh.vertices[i];
+        mesh.positions[i] = {v.x, v.y, v.z, v.w};
+        mesh.attributes[i] = {v.nx, v.ny, v.nz, v.nw, v.tx, v.ty};
+    }
+}
+
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels) {
+    size_t size = 0;
+    for (uint32_t i=0; i<mipLevels; i++) {
+        size += size_t(width) * height * 4;
+        if (width > 1) width /= 2;
+        if (height > 1) height /= 2;
+    }
+    return size;
+}
+std::vector<uint8_t> generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t mipLevels) {
+    std::vector<uint8_t> chain(mipChainSize(width, height, mipLevels));
+    memcpy(chain.data(), pixels, size_t(width) * height * 4);
+    size_t srcOffset = 0;
+    for (uint32_t level=1; level<mipLevels; level++) {
+        uint32_t dstWidth = width > 1 ? width/2 : 1;
+        uint32_t dstHeight = height > 1 ? height/2 : 1;
+        size_t dstOffset = srcOffset + size_t(width) * height * 4;
+        const uint8_t* src = chain.data() + srcOffset;
+        uint8_t* dst = chain.data() + dstOffset;
+        // average the 2x2 footprint of every texel, odd edges fold the last row or column in once
+        for (uint32_t y=0; y<dstHeight; y++) {
+            uint32_t y0 = std::min(y*2, height-1), y1 = std::min(y*2+1, height-1);
+            for (uint32_t x=0; x<dstWidth; x++) {
+                uint32_t x0 = std::min(x*2, width-1), x1 = std::min(x*2+1, width-1);
+                for (uint32_t c=0; c<4; c++) {
+                    uint32_t sum = src[(size_t(y0)*width + x0)*4 + c] + src[(size_t(y0)*width + x1)*4 + c] +
+                        src[(size_t(y1)*width + x0)*4 + c] + src[(size_t(y1)*width + x1)*4 + c];
+                    dst[(size_t(y)*dstWidth + x)*4 + c] = uint8_t((sum + 2) / 4);
+                }
+            }
+        }
+        srcOffset = dstOffset;
+        width = dstWidth;
+        height = dstHeight;
+    }
+    return chain;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "config.hpp"
+
+// asset ingest that doesn't need a device, shared by the engine and vkr-bench
+
+// reads an OBJ file and welds it into mesh, throws if the file cannot be parsed
+void loadObj(Mesh& mesh, const std::string& path);
+// turns one vertex per triangle corner into unique vertices plus indices, appending to mesh
+void weldVertices(Mesh& mesh, const std::vector<Vertex>& corners);
+// copies the vertices in [first, last) into the position and attribute streams, which are sized to the vertices
+void splitVertexStreams(Mesh& mesh, uint32_t first, uint32_t last);
+
+// size in bytes of an RGBA8 mip chain with mipLevels levels, every level tightly packed after the previous one
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+// box filtered RGBA8 mip chain with the same level sizes vkCmdBlitImage produces, level 0 is a copy of pixels
+std::vector<uint8_t> generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t mipLevels);
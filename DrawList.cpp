@@ -0,0 +1,46 @@
+#include "DrawList.hpp"
+
+uint64_t makeDrawKey(uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket) {
+    uint64_t key = pipeline & ((1u << DRAW_KEY_PIPELINE_BITS) - 1);
+    key = key << DRAW_KEY_MATERIAL_BITS | (material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1));
+    key = key << DRAW_KEY_MESH_BITS | (mesh & ((1u << DRAW_KEY_MESH_BITS) - 1));
+    key = key << DRAW_KEY_DEPTH_BITS | (depthBucket & ((1u << DRAW_KEY_DEPTH_BITS) - 1));
+    return key;
+}
+void sortDrawPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+    scratch.resize(packets.size());
+    // all eight histograms in one read of the keys
+    std::vector<std::array<uint32_t, 256>> histograms(8);
+    for (auto& histogram: histograms) histogram.fill(0);
+    for (const auto& packet: packets) {
+        for (int pass=0; pass<8; pass++) histograms[pass][(packet.key >> (pass*8)) & 0xFF]++;
+    }
+    std::vector<DrawPacket>* src = &packets;
+    std::vector<DrawPacket>* dst = &scratch;
+    for (int pass=0; pass<8; pass++) {
+        auto& histogram = histograms[pass];
+        if (packets.empty() || histogram[(packets[0].key >> (pass*8)) & 0xFF] == packets.size()) continue;
+        uint32_t offset = 0;
+        for (auto& count: histogram) {
+            uint32_t next = offset + count;
+            count = offset;
+            offset = next;
+        }
+        for (const auto& packet: *src) {
+            (*dst)[histogram[(packet.key >> (pass*8)) & 0xFF]++] = packet;
+        }
+        std::swap(src, dst);
+    }
+    if (src != &packets) packets.swap(scratch);
+}
+void collectDrawRuns(const std::vector<DrawPacket>& packets, std::vector<DrawRun>& runs) {
+    runs.clear();
+    for (uint32_t i=0; i<packets.size(); i++) {
+        uint64_t state = drawKeyState(packets[i].key);
+        uint32_t mesh = drawKeyMesh(packets[i].key);
+        if (runs.empty() || runs.back().state != state || runs.back().mesh != mesh) {
+            runs.push_back({state, mesh, i, 0});
+        }
+        runs.back().packetCount++;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "config.hpp"
+
+// the scene as a list of draw packets, one per object and frame, sorted by a 64 bit key so that objects
+// sharing state end up next to each other and collapse into a few instanced, indirect draws
+// key layout, most significant first: pipeline (8 bits), material (12), mesh (20), depth bucket (24)
+const uint32_t DRAW_KEY_DEPTH_BITS = 24;
+const uint32_t DRAW_KEY_MESH_BITS = 20;
+const uint32_t DRAW_KEY_MATERIAL_BITS = 12;
+const uint32_t DRAW_KEY_PIPELINE_BITS = 8;
+
+struct DrawPacket {
+    uint64_t key;
+    uint32_t instance;
+};
+uint64_t makeDrawKey(uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket);
+inline uint32_t drawKeyMesh(uint64_t key) {
+    return (key >> DRAW_KEY_DEPTH_BITS) & ((1u << DRAW_KEY_MESH_BITS) - 1);
+}
+// pipeline and material, what has to be bound before drawing
+inline uint64_t drawKeyState(uint64_t key) {
+    return key >> (DRAW_KEY_DEPTH_BITS + DRAW_KEY_MESH_BITS);
+}
+inline uint32_t drawStatePipeline(uint64_t state) {
+    return state >> DRAW_KEY_MATERIAL_BITS;
+}
+
+// stable LSD radix sort on the keys, 8 bits per pass, a pass is skipped when every key has the same byte there,
+// which is the common case for the state bits, scratch is resized as needed and can be kept between calls
+void sortDrawPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+// consecutive sorted packets with the same state and mesh, they become one instanced draw
+struct DrawRun {
+    uint64_t state;
+    uint32_t mesh;
+    uint32_t firstPacket;
+    uint32_t packetCount;
+};
+void collectDrawRuns(const std::vector<DrawPacket>& packets, std::vector<DrawRun>& runs);
+
+// consecutive indirect commands sharing state, one vkCmdDraw*Indirect call
+struct DrawCall {
+    uint64_t state;
+    uint32_t firstCommand;
+    uint32_t commandCount;
+};
+struct DrawListStats {
+    size_t packets = 0; // objects, each would be a draw without the list
+    size_t runs = 0;
+    size_t directDraws = 0; // draws one at a time, every packet and index group or every packet for mesh shaders
+    size_t commands = 0; // indirect commands after collapsing runs
+    size_t calls = 0;
+    double sortMs = 0.0;
+};
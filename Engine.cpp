@@ -1,5 +1,3 @@
-#define STB_IMAGE_IMPLEMENTATION
-#define TINYOBJLOADER_IMPLEMENTATION
 #include "Engine.hpp"
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     Engine* engine = reinterpret_cast<Engine*>(glfwGetWindowUserPointer(window));
@@ -11,9 +9,85 @@ void Engine::onKey(int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_M && action == GLFW_PRESS) {
         MESH_SHADERS_ENABLED = !MESH_SHADERS_ENABLED;
     }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        CULLING_ENABLED = !CULLING_ENABLED;
+    }
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        TRIANGLE_CULLING_ENABLED = !TRIANGLE_CULLING_ENABLED;
+    }
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        OCCLUSION_ENABLED = !OCCLUSION_ENABLED;
+    }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        VISIBILITY_ENABLED = !VISIBILITY_ENABLED;
+        if (VISIBILITY_ENABLED && (!MESH_SHADERS_SUPPORTED || !MESH_SHADERS_ENABLED)) {
+            std::cout << "Visibility buffer: rasterized by the mesh shader path, switch to it with M" << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+        editDemo();
+    }
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        LOD_ENABLED = !LOD_ENABLED;
+        if (lodBuffer == VK_NULL_HANDLE) {
+            std::cout << "Levels of detail: not built, start with --lod on a device with mesh shaders" << std::endl;
+        } else {
+            std::cout << "Levels of detail: " << (LOD_ENABLED ? "on" : "off") << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_A && action == GLFW_PRESS) {
+        ASYNC_COMPUTE_ENABLED = !ASYNC_COMPUTE_ENABLED;
+        if (computeQueue == VK_NULL_HANDLE) {
+            std::cout << "Async compute: no compute only queue with timeline semaphores on this device" << std::endl;
+        } else {
+            std::cout << "Async compute: " << (ASYNC_COMPUTE_ENABLED ? "on" : "off") << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        DYNAMIC_RESOLUTION_ENABLED = !DYNAMIC_RESOLUTION_ENABLED;
+        if (!sceneUpscaled) {
+            std::cout << "Dynamic resolution: off, start with --frame-budget=ms on a device that can blit to the swapchain" << std::endl;
+        } else {
+            std::cout << "Dynamic resolution: " << (DYNAMIC_RESOLUTION_ENABLED ? "on" : "off, fixed render scale") << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        TAA_ENABLED = !TAA_ENABLED;
+        if (taaPipeline == VK_NULL_HANDLE) {
+            std::cout << "Temporal upsampling: not available, start with --taa" << std::endl;
+        } else {
+            std::cout << "Temporal upsampling: " << (TAA_ENABLED ? "on, not in visibility buffer mode" : "off") << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        PREPASS_ENABLED = !PREPASS_ENABLED;
+        std::cout << "Depth prepass: " << (PREPASS_ENABLED ? "on, replaces the two-pass occlusion culling" : "off")
+            << std::endl;
+    }
+    // the hybrid rasterizer's crossover, halved or doubled per press, 0 leaves every meshlet to the mesh path
+    if ((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) && action == GLFW_PRESS) {
+        if (key == GLFW_KEY_RIGHT_BRACKET) {
+            swRasterThreshold = swRasterThreshold > 0.0f ? swRasterThreshold * 2.0f : 1.0f;
+        } else {
+            swRasterThreshold = swRasterThreshold > 1.0f ? swRasterThreshold * 0.5f : 0.0f;
+        }
+        if (clusterBuffer == VK_NULL_HANDLE) {
+            std::cout << "Hybrid rasterization: not available on this device or scene" << std::endl;
+        } else {
+            std::cout << "Hybrid rasterization: " << swRasterThreshold << " pixels per triangle" << std::endl;
+        }
+    }
 }
 
-Engine::Engine() {
+Engine::Engine(const EngineOptions& options) : options(options) {
+    // the JSON report is all that goes to stdout, so it can be parsed, everything else the engine says goes to stderr
+    if (options.meshletReportJson) reportBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    swRasterThreshold = options.swRasterThreshold;
+    lodThreshold = options.lodThreshold;
+    PREPASS_ENABLED = options.depthPrepass;
+    ASYNC_COMPUTE_ENABLED = options.asyncCompute;
+    DYNAMIC_RESOLUTION_ENABLED = options.frameBudget > 0.0f;
+    renderScale = options.renderScale;
     loadModel();
     createMeshlets();
     createWindow();
@@ -23,6 +97,8 @@ Engine::Engine() {
     createSwapchain();
     createColorResources();
     createDepthResources();
+    createDepthPyramid();
+    createVisibilityResources();
     createRenderpass();
     createFramebuffers();
     createUniformBuffers();
@@ -32,15 +108,71 @@ Engine::Engine() {
     createDescriptorPool();
     createDescriptorSets();
     createGraphicsPipeline();
+    createMeshletBuildPipeline();
+    createCullPipeline();
+    createRasterPipelines();
+    createLodPipeline();
+    createLightCullPipeline();
+    createDepthReducePipeline();
+    createTaaPipeline();
     createVertexBuffer();
+    createInstanceBuffer();
+    createLightBuffers();
     createIndexBuffer();
     createMeshletBuffer();
+    createDrawBuffers();
+    createCullBuffers();
+    createRasterBuffers();
+    createLodBuffers();
+    createCounterBuffers();
     createQueryPool();
+    if (DYNAMIC_RESOLUTION_ENABLED) {
+        std::cout << "Dynamic resolution: " << options.frameBudget << "ms GPU budget, rendering at " << MIN_RENDER_SCALE * 100.0f
+            << "% to 100% per axis" << std::endl;
+    } else if (sceneUpscaled) {
+        std::cout << "Render scale: " << options.renderScale * 100.0f << "% per axis" << std::endl;
+    }
 }
 Engine::~Engine() {
+    destroyCounterBuffers();
+    destroyLightBuffers();
+    destroyLodBuffers();
+    destroyRasterBuffers();
+    destroyCullBuffers();
+    destroyDrawBuffers();
+    destroyDrawListBuffers();
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+    vkDestroyPipeline(device, rasterClassifyPipeline, nullptr);
+    vkDestroyPipeline(device, swRasterPipeline, nullptr);
+    vkDestroyPipeline(device, swResolvePipeline, nullptr);
+    vkDestroyPipelineLayout(device, rasterPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, rasterSetLayout, nullptr);
+    vkDestroyPipeline(device, lodPipeline, nullptr);
+    vkDestroyPipelineLayout(device, lodPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, lodSetLayout, nullptr);
+    vkDestroyPipeline(device, lightCullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, lightCullPipelineLayout, nullptr);
+    vkDestroyPipeline(device, depthReducePipeline, nullptr);
+    vkDestroyPipeline(device, taaPipeline, nullptr);
+    vkDestroyPipelineLayout(device, taaPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, taaSetLayout, nullptr);
+    vkDestroySampler(device, taaSampler, nullptr);
+    vkDestroyPipelineLayout(device, depthReducePipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, depthReduceSetLayout, nullptr);
+    vkDestroySampler(device, depthPyramidSampler, nullptr);
     vkDestroyBuffer(device, meshletBuffer, nullptr);
     vkFreeMemory(device, meshletBufferMemory, nullptr);
+    vkDestroyBuffer(device, meshletCountBuffer, nullptr);
+    vkFreeMemory(device, meshletCountBufferMemory, nullptr);
+    vkDestroyPipeline(device, meshletBuildPipeline, nullptr);
+    vkDestroyPipelineLayout(device, meshletBuildPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, meshletBuildSetLayout, nullptr);
     vkDestroyQueryPool(device, queryPool, nullptr);
+    vkDestroyQueryPool(device, rasterQueryPool, nullptr);
+    vkDestroyQueryPool(device, lightQueryPool, nullptr);
+    vkDestroyQueryPool(device, prepassQueryPool, nullptr);
     cleanupSwapchain();
     vkDestroySampler(device, textureSampler, nullptr);
     vkDestroyImageView(device, textureImageView, nullptr);
@@ -52,20 +184,36 @@ Engine::~Engine() {
     }
     vkFreeMemory(device, indexBufferMemory, nullptr);
     vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
+    vkFreeMemory(device, positionBufferMemory, nullptr);
+    vkDestroyBuffer(device, positionBuffer, nullptr);
+    vkFreeMemory(device, attributeBufferMemory, nullptr);
+    vkDestroyBuffer(device, attributeBuffer, nullptr);
+    vkFreeMemory(device, instanceBufferMemory, nullptr);
+    vkDestroyBuffer(device, instanceBuffer, nullptr);
     vkDestroyPipeline(device, meshGfxPipeline, nullptr);
+    vkDestroyPipeline(device, depthPrepassPipeline, nullptr);
+    vkDestroyPipeline(device, meshDepthPrepassPipeline, nullptr);
+    vkDestroyPipeline(device, gfxEqualPipeline, nullptr);
+    vkDestroyPipeline(device, meshEqualPipeline, nullptr);
+    vkDestroyPipeline(device, visibilityPipeline, nullptr);
+    vkDestroyPipeline(device, shadePipeline, nullptr);
+    vkDestroyPipelineLayout(device, shadePipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, shadeSetLayout, nullptr);
     vkDestroyPipeline(device, gfxPipeline, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, pushDescriptorSetLayout, nullptr);
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroyPipelineLayout(device, gfxPipelineLayout, nullptr);
     vkDestroyRenderPass(device, renderpass, nullptr);
+    vkDestroyRenderPass(device, earlyRenderpass, nullptr);
+    vkDestroyRenderPass(device, lateRenderpass, nullptr);
+    vkDestroyRenderPass(device, visibilityRenderpass, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyDevice(device, nullptr);
     vkDestroyInstance(instance, nullptr);
     glfwDestroyWindow(window);
     glfwTerminate();
+    if (reportBuffer) std::cout.rdbuf(reportBuffer);
 }
 void Engine::run() {
     VkCommandPool gfxCommandPool = createCommandPool(queueFamilies.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
@@ -75,17 +223,91 @@ void Engine::run() {
     for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) imageAvailable[i] = createSemaphore();
     std::vector<VkSemaphore> renderDone(MAX_FRAMES_IN_FLIGHT);
     for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) renderDone[i] = createSemaphore();
-    std::vector<VkFence> cmdBufferReady(MAX_FRAMES_IN_FLIGHT);
+    cmdBufferReady.resize(MAX_FRAMES_IN_FLIGHT);
     for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) cmdBufferReady[i] = createFence(VK_FENCE_CREATE_SIGNALED_BIT);
+    // async compute: a command buffer per frame in flight on the compute queue, the timeline semaphore's value is
+    // the number of frames it has finished, the graphics submit of a frame waits for its value
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> computeCommandBuffers(MAX_FRAMES_IN_FLIGHT);
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    uint64_t computeFrames = 0;
+    if (computeQueue != VK_NULL_HANDLE) {
+        computeCommandPool = createCommandPool(queueFamilies.computeFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) computeCommandBuffers[i] = createCommandBuffer(computeCommandPool);
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &computeTimeline));
+    }
     
     double lastTime = glfwGetTime();
+    double lastFrameTime = lastTime;
+    int lastFrameAsync = -1; // whether the last frame binned its lights on the compute queue, -1 if it didn't compare
     uint32_t currFrame = 0;
     int framesPassed = 0;
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
+        flushMeshEdits();
 
         // wait until this command buffer is ready to be rerecorded
         vkWaitForFences(device, 1, &cmdBufferReady[currFrame], VK_TRUE, ~0ull);
+        double frameTime = glfwGetTime();
+        if (lastFrameAsync >= 0) {
+            std::vector<double>& times = lastFrameAsync ? asyncFrameTimes : syncFrameTimes;
+            times.push_back((frameTime - lastFrameTime) * 1000.0);
+            if (times.size() > 120) times.erase(times.begin());
+        }
+        lastFrameTime = frameTime;
+        lastFrameAsync = -1;
+        updateRenderScale(currFrame);
+        if (rasterTimedPasses[currFrame] > 0) {
+            // the frame that last used this slot is done, so are its timestamps
+            uint64_t timestamps[3];
+            vkGetQueryPoolResults(device, rasterQueryPool, currFrame * 3, rasterTimedPasses[currFrame] + 1,
+                sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            hwRasterMs += (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+            hwRasterFrames++;
+            if (rasterTimedPasses[currFrame] > 1) {
+                swRasterMs += (timestamps[2] - timestamps[1]) * timestampPeriod / 1000000.0;
+                swRasterFrames++;
+            }
+            rasterTimedPasses[currFrame] = 0;
+        }
+        if (lightCullTimed[currFrame]) {
+            uint64_t timestamps[2];
+            vkGetQueryPoolResults(device, lightQueryPool, currFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT);
+            lightCullMs += (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+            lightCullFrames++;
+            lightCullTimed[currFrame] = false;
+            if (asyncComputeTimed[currFrame]) {
+                // the graphics queue's own duration of the same frame, timestamps are only comparable within a
+                // queue, so how much the two overlapped can't be told from them
+                uint64_t frame[2];
+                vkGetQueryPoolResults(device, queryPool, currFrame * 2, 2, sizeof(frame), frame, sizeof(uint64_t),
+                    VK_QUERY_RESULT_64_BIT);
+                asyncGraphicsMs += (frame[1] - frame[0]) * timestampPeriod / 1000000.0;
+                asyncComputeFrames++;
+                asyncComputeTimed[currFrame] = false;
+            }
+        }
+        if (prepassTimed[currFrame]) {
+            uint64_t timestamps[3];
+            vkGetQueryPoolResults(device, prepassQueryPool, currFrame * 3, 3, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT);
+            depthPrepassMs += (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+            shadePassMs += (timestamps[2] - timestamps[1]) * timestampPeriod / 1000000.0;
+            prepassFrames++;
+            prepassTimed[currFrame] = false;
+        }
+        if (countersWritten[currFrame]) {
+            memcpy(&pipelineCounters, (char*)counterReadbackMapped + counterStride*currFrame, sizeof(PipelineCounters));
+            countersWritten[currFrame] = false;
+        }
         
         // acquire free image from swapchain
         uint32_t imageIndex;
@@ -100,7 +322,29 @@ void Engine::run() {
         vkResetFences(device, 1, &cmdBufferReady[currFrame]);
         vkResetCommandBuffer(gfxCommandBuffers[currFrame], 0);
 
-        recordCommandBuffer(gfxCommandBuffers[currFrame], imageIndex, currFrame);
+        // the light binning only depends on the frame's matrices, so it can run on the compute queue while the
+        // graphics queue culls and rasterizes, the graphics queue waits for it at the fragment shaders
+        bool asyncCompute = ASYNC_COMPUTE_ENABLED && computeQueue != VK_NULL_HANDLE && lightCullPipeline != VK_NULL_HANDLE;
+        if (computeQueue != VK_NULL_HANDLE && lightCullPipeline != VK_NULL_HANDLE) lastFrameAsync = asyncCompute;
+        recordCommandBuffer(gfxCommandBuffers[currFrame], imageIndex, currFrame, asyncCompute);
+        if (asyncCompute) {
+            // this slot's fence is signaled, so the graphics work that waited for its last compute work is done too
+            vkResetCommandBuffer(computeCommandBuffers[currFrame], 0);
+            recordAsyncCompute(computeCommandBuffers[currFrame], currFrame);
+            computeFrames++;
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &computeFrames;
+            VkSubmitInfo computeInfo{};
+            computeInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            computeInfo.pNext = &timelineInfo;
+            computeInfo.commandBufferCount = 1;
+            computeInfo.pCommandBuffers = &computeCommandBuffers[currFrame];
+            computeInfo.signalSemaphoreCount = 1;
+            computeInfo.pSignalSemaphores = &computeTimeline;
+            VK_CHECK(vkQueueSubmit(computeQueue, 1, &computeInfo, VK_NULL_HANDLE));
+        }
         
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -108,10 +352,18 @@ void Engine::run() {
         submitInfo.pCommandBuffers = &gfxCommandBuffers[currFrame];
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = &renderDone[currFrame];
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &imageAvailable[currFrame];
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        submitInfo.waitSemaphoreCount = asyncCompute ? 2 : 1;
+        VkSemaphore waitSemaphores[] = {imageAvailable[currFrame], computeTimeline};
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
         submitInfo.pWaitDstStageMask = waitStages;
+        // the binary semaphore's value is ignored
+        uint64_t waitValues[] = {0, computeFrames};
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 2;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        if (asyncCompute) submitInfo.pNext = &timelineInfo;
         VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, cmdBufferReady[currFrame]));
 
         VkPresentInfoKHR presentInfo{};
@@ -143,10 +395,6 @@ void Engine::run() {
             uint64_t startTime = queryResults[prevFrame * 2];
             uint64_t endTime = queryResults[prevFrame * 2 + 1];
             
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(pDevice, &props);
-            float timestampPeriod = props.limits.timestampPeriod;
-            
             double gpuTimeMs = (endTime - startTime) * timestampPeriod / 1000000.0;
             
             gpuTimes.push_back(gpuTimeMs);
@@ -166,7 +414,53 @@ void Engine::run() {
                     << " FPS, GPU: " << std::setprecision(3) << avgGpuTime 
                     << "ms (avg " << gpuTimes.size() << " frames), "
                     << "Triangles: " << mesh.indices.size()/3 <<", "
-                    << "Meshlets: " << mesh.meshlets.size();
+                    << "Instances: " << instances.size() << ", "
+                    << "Draw calls: " << drawListStats.calls << ", "
+                    << "Meshlets: " << (options.gpuMeshlets ? gpuMeshletCount : mesh.meshlets.size());
+                if (pipelineCounters.meshletsTested > 0) {
+                    title << ", Culled: " << pipelineCounters.frustumCulled << " frustum, " << pipelineCounters.coneCulled
+                        << " cone, " << pipelineCounters.occlusionCulled << " occlusion of " << pipelineCounters.meshletsTested;
+                }
+                if (pipelineCounters.trianglesEmitted > 0) {
+                    title << ", Emitted: " << pipelineCounters.trianglesEmitted;
+                }
+                if (hwRasterFrames > 0) {
+                    title << ", HW raster: " << std::setprecision(3) << hwRasterMs / hwRasterFrames << "ms";
+                    if (swRasterFrames > 0) {
+                        title << ", SW raster: " << swRasterMs / swRasterFrames << "ms at "
+                            << std::setprecision(1) << swRasterThreshold << " px/triangle";
+                    }
+                }
+                if (lightCullFrames > 0) {
+                    title << ", Lights: " << lights.size() << " binned in " << std::setprecision(3)
+                        << lightCullMs / lightCullFrames << "ms";
+                    if (asyncComputeFrames > 0) {
+                        title << " on the compute queue beside " << asyncGraphicsMs / asyncComputeFrames << "ms of graphics";
+                    }
+                }
+                if (!asyncFrameTimes.empty() && !syncFrameTimes.empty()) {
+                    auto average = [](const std::vector<double>& times) {
+                        double sum = 0.0;
+                        for (double time: times) sum += time;
+                        return sum / times.size();
+                    };
+                    title << ", Frame: " << std::setprecision(3) << average(asyncFrameTimes) << "ms with async compute, "
+                        << average(syncFrameTimes) << "ms without";
+                }
+                if (sceneUpscaled) {
+                    title << ", Resolution: " << renderExtent.width << "x" << renderExtent.height << " ("
+                        << std::setprecision(0) << 100.0f * renderExtent.width / swapchainExtent.width << "%)";
+                    if (DYNAMIC_RESOLUTION_ENABLED) {
+                        title << " for " << std::setprecision(1) << options.frameBudget << "ms";
+                    }
+                    if (historyValid) title << " with TAA";
+                }
+                if (prepassFrames > 0) {
+                    title << ", Depth prepass: " << std::setprecision(3) << depthPrepassMs / prepassFrames
+                        << "ms + shading " << shadePassMs / prepassFrames << "ms";
+                }
+                hwRasterMs = swRasterMs = lightCullMs = depthPrepassMs = shadePassMs = asyncGraphicsMs = 0.0;
+                hwRasterFrames = swRasterFrames = lightCullFrames = prepassFrames = asyncComputeFrames = 0;
                 glfwSetWindowTitle(window, title.str().c_str());
                 framesPassed = 0;
                 lastTime = currentTime;
@@ -174,99 +468,119 @@ void Engine::run() {
         }
     }
     vkQueueWaitIdle(graphicsQueue);
+    if (computeQueue != VK_NULL_HANDLE) {
+        vkQueueWaitIdle(computeQueue);
+        vkDestroyCommandPool(device, computeCommandPool, nullptr);
+        vkDestroySemaphore(device, computeTimeline, nullptr);
+    }
     vkDestroyCommandPool(device, gfxCommandPool, nullptr);
     for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroyFence(device, cmdBufferReady[i], nullptr);
+        cmdBufferReady[i] = VK_NULL_HANDLE;
         vkDestroySemaphore(device, imageAvailable[i], nullptr);
         vkDestroySemaphore(device, renderDone[i], nullptr);
     }
 }
 void Engine::loadModel() {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
-    std::string warn;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str(), nullptr)) {
-        throw std::runtime_error(err);
-    }
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
-            vertex.x = floatToHalf(attrib.vertices[3 * index.vertex_index + 0]);
-            vertex.y = floatToHalf(attrib.vertices[3 * index.vertex_index + 1]);
-            vertex.z = floatToHalf(attrib.vertices[3 * index.vertex_index + 2]);
-            vertex.tx = floatToHalf(attrib.texcoords[2 * index.texcoord_index + 0]);
-            vertex.ty = floatToHalf(1.0f - attrib.texcoords[2 * index.texcoord_index + 1]);
-            glm::vec3 normal = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2],
-            };
-            normal = glm::normalize(normal);
-            // input float is [-1.0, 1.0], we need to convert it to [0, 255] to fit into uint8_t
-            vertex.nx = uint8_t((normal.x*0.5f+0.5f)*255.0f);
-            vertex.ny = uint8_t((normal.y*0.5f+0.5f)*255.0f);
-            vertex.nz = uint8_t((normal.z*0.5f+0.5f)*255.0f);
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(mesh.vertices.size());
-                mesh.vertices.push_back(vertex);
-            }
-            mesh.indices.push_back(uniqueVertices[vertex]);
-        }
+    // the model (or the synthetic mesh replacing it) comes first, then the extra meshes,
+    // each is meshletized on its own and appended to the pool, so no meshlet spans two meshes
+    std::vector<EngineOptions::MeshSource> sources = {{MODEL_PATH, options.syntheticKind, options.syntheticTriangles}};
+    sources.insert(sources.end(), options.meshes.begin(), options.meshes.end());
+    if (options.gpuMeshlets && sources.size() > 1) {
+        throw std::runtime_error("the GPU meshlet build takes a single mesh, it can't be combined with more meshes");
     }
-}
-void Engine::createMeshlets() {
-    const uint32_t MAX_VERTICES = 64;
-    const uint32_t MAX_TRIANGLES = 126;
-    uint32_t triangleCount = mesh.indices.size() / 3;
-    uint32_t currentTriangle = 0;
-    while (currentTriangle < triangleCount) {
-        Meshlet meshlet = {};
-        std::unordered_set<uint32_t> meshletVertexSet;
-        std::vector<uint32_t> meshletVertexList;
-        std::vector<uint8_t> meshletIndicesList;
-        uint32_t trianglesInMeshlet = 0;
-        while (currentTriangle < triangleCount && trianglesInMeshlet < MAX_TRIANGLES) {
-            uint32_t i0 = mesh.indices[currentTriangle * 3 + 0];
-            uint32_t i1 = mesh.indices[currentTriangle * 3 + 1];
-            uint32_t i2 = mesh.indices[currentTriangle * 3 + 2];
-            std::unordered_set<uint32_t> potentialVertices = meshletVertexSet;
-            potentialVertices.insert(i0);
-            potentialVertices.insert(i1);
-            potentialVertices.insert(i2);
-            if (potentialVertices.size() > MAX_VERTICES) {
-                break;
+    if (options.lod && options.gpuMeshlets) {
+        throw std::runtime_error("levels of detail are built from the CPU meshlets, they can't be combined with --gpu-meshlets");
+    }
+    // the levels' meshlets go after every mesh's own, so the meshlets of level 0 stay in index order
+    std::vector<std::vector<LodLevel>> levels;
+    std::vector<std::vector<Mesh>> levelMeshlets;
+    for (const auto& source: sources) {
+        Mesh part;
+        if (!source.syntheticKind.empty()) {
+            if (!generateSyntheticMesh(part, source.syntheticKind, source.syntheticTriangles)) {
+                throw std::runtime_error("unknown synthetic mesh: " + source.syntheticKind);
             }
-            auto addVertex = [&](uint32_t globalIdx) -> uint8_t {
-                if (meshletVertexSet.find(globalIdx) == meshletVertexSet.end()) {
-                    meshletVertexSet.insert(globalIdx);
-                    meshletVertexList.push_back(globalIdx);
-                }
-                for (uint8_t i = 0; i < meshletVertexList.size(); i++) {
-                    if (meshletVertexList[i] == globalIdx) return i;
-                }
-                return 0;
-            };
-            uint8_t localI0 = addVertex(i0);
-            uint8_t localI1 = addVertex(i1);  
-            uint8_t localI2 = addVertex(i2);
-            meshletIndicesList.push_back(localI0);
-            meshletIndicesList.push_back(localI1);
-            meshletIndicesList.push_back(localI2);
-            trianglesInMeshlet++;
-            currentTriangle++;
+            std::cout << "Synthetic " << source.syntheticKind << ": " << part.indices.size()/3 << " triangles, "
+                << part.vertices.size() << " vertices" << std::endl;
+        } else {
+            loadObj(part, source.path);
         }
-        meshlet.vertexCount = meshletVertexList.size();
-        meshlet.triangleCount = meshletIndicesList.size()/3;
-        for (size_t i = 0; i < meshletVertexList.size(); i++) {
-            meshlet.vertices[i] = meshletVertexList[i];
+        if (!options.gpuMeshlets) buildMeshlets(part);
+        if (options.lod) {
+            glm::vec4 sphere = computeMeshSphere(part);
+            levels.emplace_back();
+            buildLodLevels(part, levels.back());
+            // a level only keeps its meshlets, they are built against the part's vertices which the pool keeps
+            levelMeshlets.emplace_back(levels.back().size());
+            for (size_t l=0; l<levels.back().size(); l++) {
+                Mesh& level = levelMeshlets.back()[l];
+                level.vertices = part.vertices;
+                level.indices = levels.back()[l].indices;
+                buildMeshlets(level);
+                level.vertices.clear();
+                level.indices.clear();
+            }
+            MeshLod base{};
+            base.center = glm::vec3(sphere);
+            base.radius = sphere.w;
+            meshLods.resize(meshLods.size() + LOD_MAX_LEVELS, base);
         }
-        for (size_t i = 0; i < meshletIndicesList.size(); i++) {
-            meshlet.indices[i] = meshletIndicesList[i];
+        meshRanges.push_back(appendMesh(mesh, part));
+    }
+    for (uint32_t m=0; m<levels.size(); m++) {
+        MeshLod* rows = &meshLods[m * LOD_MAX_LEVELS];
+        rows[0].meshletOffset = meshRanges[m].meshletOffset;
+        rows[0].meshletCount = meshRanges[m].meshletCount;
+        std::cout << "Levels of detail " << m << ": " << meshRanges[m].indexCount/3;
+        for (uint32_t l=0; l<levels[m].size(); l++) {
+            const Mesh& level = levelMeshlets[m][l];
+            rows[l+1].meshletOffset = appendMeshlets(mesh, level, meshRanges[m].vertexOffset);
+            rows[l+1].meshletCount = level.meshlets.size();
+            rows[l+1].error = levels[m][l].error;
+            std::cout << ", " << levels[m][l].indices.size()/3;
         }
-        mesh.meshlets.push_back(meshlet);
+        std::cout << " triangles" << std::endl;
+    }
+    if (meshRanges.size() > 1) {
+        std::cout << "Geometry pool: " << meshRanges.size() << " meshes, " << mesh.indices.size()/3 << " triangles, "
+            << mesh.vertices.size() << " vertices" << std::endl;
+    }
+}
+void Engine::createMeshlets() {
+    if (options.gpuMeshlets) {
+        std::cout << "Meshlets: built on the GPU" << std::endl;
+        return;
+    }
+    // they were built mesh by mesh in loadModel, this only reports on the whole pool, the meshlets of the levels
+    // of detail sit behind the meshes' own and only the meshes' own are reported on
+    uint32_t meshletCount = meshRanges.back().meshletOffset + meshRanges.back().meshletCount;
+    Mesh levelZero;
+    const Mesh& reported = meshletCount < mesh.meshlets.size() ? levelZero : mesh;
+    if (meshletCount < mesh.meshlets.size()) {
+        const Meshlet& first = mesh.meshlets[meshletCount];
+        levelZero.meshlets.assign(mesh.meshlets.begin(), mesh.meshlets.begin() + meshletCount);
+        levelZero.meshletBounds.assign(mesh.meshletBounds.begin(), mesh.meshletBounds.begin() + meshletCount);
+        levelZero.meshletVertices.assign(mesh.meshletVertices.begin(), mesh.meshletVertices.begin() + first.vertexOffset);
+        levelZero.meshletTriangles.assign(mesh.meshletTriangles.begin(), mesh.meshletTriangles.begin() + first.triangleOffset);
+    }
+
+    // the old layout reserved 64 vertices and 126 triangles for every meshlet,
+    // unpacked streams store 32 bit vertex indices and 8 bit local indices
+    size_t fixedSize = (sizeof(uint32_t)*64 + sizeof(uint8_t)*126*3 + 2)*reported.meshlets.size();
+    size_t unpackedSize = (sizeof(uint32_t)*3)*reported.meshlets.size();
+    for (const auto& meshlet: reported.meshlets) {
+        unpackedSize += sizeof(uint32_t)*meshlet.vertexCount + sizeof(uint8_t)*3*meshlet.triangleCount;
+    }
+    size_t packedSize = sizeof(Meshlet)*reported.meshlets.size() + sizeof(uint32_t)*reported.meshletVertices.size() +
+        sizeof(uint32_t)*reported.meshletTriangles.size();
+    std::cout << "Meshlets: " << reported.meshlets.size() << ", " << packedSize << " bytes (unpacked streams: "
+        << unpackedSize << " bytes, fixed layout: " << fixedSize << " bytes)";
+    if (&reported != &mesh) std::cout << ", levels of detail: " << mesh.meshlets.size() - meshletCount << " more";
+    std::cout << std::endl;
+    if (options.meshletReport) {
+        std::ostream out(reportBuffer ? reportBuffer : std::cout.rdbuf());
+        printMeshletReport(computeMeshletReport(reported), out, options.meshletReportJson);
     }
 }
 void Engine::createWindow() {
@@ -321,13 +635,30 @@ void Engine::createDevice() {
         if (isDeviceSuitable(dev)) {
             pDevice = dev;
             msaaSamples = getMaxSamples();
+            VkPhysicalDeviceProperties props{};
+            vkGetPhysicalDeviceProperties(pDevice, &props);
+            standardSampleLocations = props.limits.standardSampleLocations;
+            maxComputeWorkGroupCountX = props.limits.maxComputeWorkGroupCount[0];
+            timestampPeriod = props.limits.timestampPeriod;
+            storageBufferAlignment = props.limits.minStorageBufferOffsetAlignment;
             break;
         }
     }
     if (pDevice == VK_NULL_HANDLE) throw std::runtime_error("Error: no suitable physical device");
     queueFamilies = getQueueFamilies(pDevice);
     isMeshShaderSupported();
-    if (MESH_SHADERS_SUPPORTED) requiredDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    if (MESH_SHADERS_SUPPORTED) {
+        requiredDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        VkPhysicalDeviceMeshShaderPropertiesEXT meshProps{};
+        meshProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 props2{};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &meshProps;
+        vkGetPhysicalDeviceProperties2(pDevice, &props2);
+        maxMeshWorkGroupCount[0] = meshProps.maxMeshWorkGroupCount[0];
+        maxMeshWorkGroupCount[1] = meshProps.maxMeshWorkGroupCount[1];
+        maxMeshWorkGroupTotalCount = meshProps.maxMeshWorkGroupTotalCount;
+    }
 
     VkDeviceCreateInfo deviceInfo{};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -342,38 +673,81 @@ void Engine::createDevice() {
     features.features.geometryShader = VK_TRUE;
     features.features.samplerAnisotropy = VK_TRUE;
     features.features.sampleRateShading = VK_TRUE;
+    features.features.multiDrawIndirect = VK_TRUE; // one indirect draw per visible meshlet
+    features.features.drawIndirectFirstInstance = VK_TRUE; // the draws address their instances through firstInstance
     VkPhysicalDeviceVulkan12Features features12{};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.shaderInt8 = VK_TRUE;
     features12.shaderFloat16 = VK_TRUE;
     features12.storageBuffer8BitAccess = VK_TRUE;
-    VkPhysicalDevice16BitStorageFeatures features16{};
-    features16.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES;
-    features16.storageBuffer16BitAccess = VK_TRUE;
+    features12.drawIndirectCount = VK_TRUE;
+    // 64 bit atomics for the compute rasterizer, which is left off without them
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supported{};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(pDevice, &supported);
+    bufferInt64Atomics = supported.features.shaderInt64 && supported12.shaderBufferInt64Atomics;
+    if (bufferInt64Atomics) {
+        features.features.shaderInt64 = VK_TRUE;
+        features12.shaderBufferInt64Atomics = VK_TRUE;
+    }
+    // async compute needs a compute only family that can write timestamps, and timeline semaphores to wait on it
+    bool asyncCompute = false;
+    if (queueFamilies.computeFamily.has_value() && supported12.timelineSemaphore) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &familyCount, families.data());
+        asyncCompute = families[queueFamilies.computeFamily.value()].timestampValidBits > 0;
+    }
+    if (asyncCompute) features12.timelineSemaphore = VK_TRUE;
+    // the 1.1 features replace VkPhysicalDevice16BitStorageFeatures, the two can't be chained together
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.storageBuffer16BitAccess = VK_TRUE;
     VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
     VkPhysicalDeviceMaintenance4Features maintenanceFeatures{};
     if (MESH_SHADERS_SUPPORTED) {
+        // shader.mesh finds its indirect draw through gl_DrawIDARB
+        features11.shaderDrawParameters = VK_TRUE;
         meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
         meshShaderFeatures.meshShader = VK_TRUE;
-        features16.pNext = &meshShaderFeatures;
+        features11.pNext = &meshShaderFeatures;
         maintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_4_FEATURES;
         maintenanceFeatures.maintenance4 = VK_TRUE;
         meshShaderFeatures.pNext = &maintenanceFeatures;
     }
-    features12.pNext = &features16;
+    features12.pNext = &features11;
     features.pNext = &features12;
     deviceInfo.pNext = &features;
 
     std::set<uint32_t> uniqueFamilies = {
         queueFamilies.graphicsFamily.value(), queueFamilies.presentFamily.value(), queueFamilies.transferFamily.value()
     };
+    if (asyncCompute) uniqueFamilies.insert(queueFamilies.computeFamily.value());
+    // without a family of their own, uploads take the compute family's second queue so that a copy never waits
+    // behind the binning, a family with a single queue is shared by both, which only costs the overlap
+    uint32_t transferQueueIndex = 0;
+    if (asyncCompute && queueFamilies.transferFamily == queueFamilies.computeFamily) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &familyCount, families.data());
+        if (families[queueFamilies.computeFamily.value()].queueCount > 1) {
+            transferQueueIndex = 1;
+        } else {
+            std::cout << "Uploads share the async compute queue, the device has no other queue for them" << std::endl;
+        }
+    }
     std::vector<VkDeviceQueueCreateInfo> queueInfos;
-    float priorioty = 1.0f;
+    float priorioty[] = {1.0f, 1.0f};
     for (const auto family: uniqueFamilies) {
         VkDeviceQueueCreateInfo queueInfo{};
         queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueInfo.pQueuePriorities = &priorioty;
-        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = priorioty;
+        queueInfo.queueCount = family == queueFamilies.transferFamily ? transferQueueIndex + 1 : 1;
         queueInfo.queueFamilyIndex = family;
         queueInfos.push_back(queueInfo);
     }
@@ -384,7 +758,8 @@ void Engine::createDevice() {
 
     vkGetDeviceQueue(device, queueFamilies.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, queueFamilies.presentFamily.value(), 0, &presentQueue);
-    vkGetDeviceQueue(device, queueFamilies.transferFamily.value(), 0, &transferQueue);
+    vkGetDeviceQueue(device, queueFamilies.transferFamily.value(), transferQueueIndex, &transferQueue);
+    if (asyncCompute) vkGetDeviceQueue(device, queueFamilies.computeFamily.value(), 0, &computeQueue);
 }
 bool Engine::isDeviceSuitable(VkPhysicalDevice dev) {
     VkPhysicalDeviceFeatures features{};
@@ -405,6 +780,8 @@ bool Engine::isDeviceSuitable(VkPhysicalDevice dev) {
     return features.geometryShader == VK_TRUE &&
         features.samplerAnisotropy == VK_TRUE && // anisotropic filtering is required to handle undersampling
         features.sampleRateShading == VK_TRUE && // enable sample shading 
+        features.multiDrawIndirect == VK_TRUE && // the culled and batched draws are multi-draw indirect
+        features.drawIndirectFirstInstance == VK_TRUE && // and start at their instances' slot in the order buffer
         props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
         requestedExtensions.empty() &&
         _queueFamilies.isComplete() &&
@@ -418,23 +795,41 @@ QueueFamilies Engine::getQueueFamilies(VkPhysicalDevice dev) {
     vkGetPhysicalDeviceQueueFamilyProperties(dev, &count, queues.data());
     int i = 0;
     QueueFamilies _queueFamilies{};
+    // transfer families without graphics, the ones without compute are copy engines that nothing else runs on
+    std::vector<uint32_t> copyFamilies, computeTransferFamilies;
     for (const auto family: queues) {
-        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            _queueFamilies.graphicsFamily = i;
+        // the first compute family without graphics, its queue runs next to the graphics queue
+        if (family.queueFlags & VK_QUEUE_COMPUTE_BIT && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                !_queueFamilies.computeFamily.has_value()) {
+            _queueFamilies.computeFamily = i;
         }
         if (family.queueFlags & VK_QUEUE_TRANSFER_BIT && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
-            _queueFamilies.transferFamily = i;
+            (family.queueFlags & VK_QUEUE_COMPUTE_BIT ? computeTransferFamilies : copyFamilies).push_back(i);
+        }
+        if (_queueFamilies.graphicsFamily.has_value() && _queueFamilies.presentFamily.has_value()) {
+            i++;
+            continue;
+        }
+        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            _queueFamilies.graphicsFamily = i;
         }
         VkBool32 presentSupported = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupported);
         if (presentSupported == VK_TRUE) {
             _queueFamilies.presentFamily = i;
         }
-        if (_queueFamilies.isComplete()) {
-            break;
-        }
         i++;
     }
+    // uploads stay off the async compute family when another one can take them, if none can they get a second queue
+    // of the compute family, or share its queue when it has only one, see createDevice
+    for (const auto family: computeTransferFamilies) {
+        if (family != _queueFamilies.computeFamily) copyFamilies.push_back(family);
+    }
+    if (!copyFamilies.empty()) {
+        _queueFamilies.transferFamily = copyFamilies.front();
+    } else if (!computeTransferFamilies.empty()) {
+        _queueFamilies.transferFamily = computeTransferFamilies.front();
+    }
     return _queueFamilies;
 }
 void Engine::createSurface() {
@@ -458,6 +853,21 @@ void Engine::createSwapchain() {
     swapchainInfo.imageExtent = swapchainExtent;
     swapchainInfo.imageFormat = surfaceFormat.format;
     swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (options.frameBudget > 0.0f || options.renderScale < 1.0f || options.taa) {
+        // the scaled frame, or the temporal upsampler's history, is blitted into the swapchain image
+        VkFormatProperties props{};
+        vkGetPhysicalDeviceFormatProperties(pDevice, swapchainFormat, &props);
+        VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        sceneUpscaled = (props.optimalTilingFeatures & blit) == blit &&
+            (surfaceDetails.cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        if (sceneUpscaled) {
+            swapchainInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        } else {
+            std::cout << "Upscaling: the swapchain can't be blitted to, rendering at full resolution" << std::endl;
+            DYNAMIC_RESOLUTION_ENABLED = false;
+        }
+    }
     swapchainInfo.minImageCount = surfaceDetails.cap.minImageCount+1;
     if (swapchainInfo.minImageCount > surfaceDetails.cap.maxImageCount && surfaceDetails.cap.maxImageCount>0) {
         swapchainInfo.minImageCount = surfaceDetails.cap.maxImageCount; 
@@ -486,34 +896,51 @@ void Engine::createSwapchain() {
     }
 }
 void Engine::createRenderpass() {
+    // all three share the attachments, so they work with the same framebuffers
+    renderpass = createRenderpass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+    // two pass occlusion culling: the early pass keeps its depth for the depth pyramid and its color for the late pass
+    earlyRenderpass = createRenderpass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE);
+    lateRenderpass = createRenderpass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+    if (MESH_SHADERS_SUPPORTED) visibilityRenderpass = createVisibilityRenderpass();
+}
+// loadOp applies to color and depth, depthStoreOp to depth only, only a pass that doesn't
+// continue in a later one resolves into the swapchain image, or into sceneImage with dynamic resolution,
+// with a single sample there is nothing to resolve and the passes draw into that image directly
+VkRenderPass Engine::createRenderpass(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp depthStoreOp) {
+    bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+    bool last = depthStoreOp == VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    VkImageLayout presentLayout = sceneUpscaled ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     // attachments must be in the sam order they are provided in the framebuffer
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = swapchainFormat;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.initialLayout = load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = !resolve && last ? presentLayout : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     colorAttachment.samples = msaaSamples;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.loadOp = loadOp;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
+    // the temporal upsampler reprojects with the depth of the last pass
+    bool temporal = options.taa && sceneUpscaled;
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = depthFormat;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout = load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.samples = msaaSamples;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.loadOp = loadOp;
+    depthAttachment.storeOp = temporal ? VK_ATTACHMENT_STORE_OP_STORE : depthStoreOp;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
     VkAttachmentDescription colorResolveAttachment{};
     colorResolveAttachment.format = swapchainFormat;
     colorResolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorResolveAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorResolveAttachment.finalLayout = presentLayout;
     colorResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorResolveAttachment.storeOp = last ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorResolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorResolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
@@ -540,7 +967,7 @@ void Engine::createRenderpass() {
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorResolveAttachmentRef;
+    subpass.pResolveAttachments = resolve ? &colorResolveAttachmentRef : nullptr;
 
     VkSubpassDependency dep{};
     dep.srcSubpass = VK_SUBPASS_EXTERNAL; // implicit subpass before or after the rendering pass
@@ -553,25 +980,47 @@ void Engine::createRenderpass() {
         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | 
         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT; // we clear the depth buffer first
+    if (load) {
+        // the late pass picks up where the early one stopped
+        dep.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    }
+    // the scene image is blitted into the swapchain once resolved, the previous frame's blit has to be done reading it
+    VkSubpassDependency resolveDep{};
+    resolveDep.srcSubpass = 0;
+    resolveDep.dstSubpass = VK_SUBPASS_EXTERNAL;
+    resolveDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    resolveDep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    resolveDep.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    resolveDep.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    if (sceneUpscaled) dep.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    // as does the previous frame's temporal upsampler with the scene image and the depth
+    if (temporal) dep.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubpassDependency deps[] = {dep, resolveDep};
 
     VkRenderPassCreateInfo renderpassInfo{};
     renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderpassInfo.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+    renderpassInfo.attachmentCount = resolve ? 3 : 2;
     renderpassInfo.pAttachments = attachments;
     renderpassInfo.subpassCount = 1;
     renderpassInfo.pSubpasses = &subpass;
-    renderpassInfo.dependencyCount = 1;
-    renderpassInfo.pDependencies = &dep;
-    VK_CHECK(vkCreateRenderPass(device, &renderpassInfo, nullptr, &renderpass));
+    renderpassInfo.dependencyCount = sceneUpscaled ? 2 : 1;
+    renderpassInfo.pDependencies = deps;
+    VkRenderPass pass;
+    VK_CHECK(vkCreateRenderPass(device, &renderpassInfo, nullptr, &pass));
+    return pass;
 }
 void Engine::createFramebuffers() {
     swapchainFramebuffers.resize(swapchainImages.size());
     for (int i=0; i<swapchainFramebuffers.size(); i++) {
-        VkImageView attachments[] = {colorImageView, depthImageView, swapchainImageViews[i]};
+        VkImageView target = sceneUpscaled ? sceneImageView : swapchainImageViews[i];
+        VkImageView attachments[] = {colorImageView, depthImageView, target};
+        // with a single sample the target is the color attachment, see createRenderpass
+        bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+        if (!resolve) attachments[0] = target;
         
         VkFramebufferCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        info.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+        info.attachmentCount = resolve ? 3 : 2;
         info.pAttachments = attachments;
         info.renderPass = renderpass;
         info.width = swapchainExtent.width;
@@ -579,8 +1028,119 @@ void Engine::createFramebuffers() {
         info.layers = 1;
         VK_CHECK(vkCreateFramebuffer(device, &info, nullptr, &swapchainFramebuffers[i]));
     }
+    if (visibilityRenderpass != VK_NULL_HANDLE) {
+        // the visibility pass doesn't touch the swapchain image, one framebuffer does for all of them
+        VkImageView attachments[] = {visibilityImageView, visibilityDepthImageView};
+        VkFramebufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+        info.pAttachments = attachments;
+        info.renderPass = visibilityRenderpass;
+        info.width = swapchainExtent.width;
+        info.height = swapchainExtent.height;
+        info.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(device, &info, nullptr, &visibilityFramebuffer));
+    }
 }
-void Engine::recordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame) {
+// ids of the triangle covering each pixel and a depth buffer to find it, both single sampled
+VkRenderPass Engine::createVisibilityRenderpass() {
+    VkAttachmentDescription idAttachment{};
+    idAttachment.format = VK_FORMAT_R32G32_UINT;
+    idAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    idAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL; // read as a storage image by the shading pass
+    idAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    idAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    idAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    idAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    idAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depthFormat;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    // the hybrid rasterizer's resolve compares against it
+    depthAttachment.finalLayout = visibilityDepthSampled ?
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.storeOp = visibilityDepthSampled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkAttachmentDescription attachments[] = {idAttachment, depthAttachment};
+    VkAttachmentReference idAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &idAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    std::array<VkSubpassDependency, 2> deps{};
+    // the previous frame's shading has to be done reading the ids before they are cleared
+    deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    deps[0].dstSubpass = 0;
+    deps[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    deps[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    // and this frame's shading reads them once they are written, as does the hybrid rasterizer's resolve,
+    // which also writes them and reads the depth
+    deps[1].srcSubpass = 0;
+    deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    deps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderpassInfo{};
+    renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderpassInfo.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+    renderpassInfo.pAttachments = attachments;
+    renderpassInfo.subpassCount = 1;
+    renderpassInfo.pSubpasses = &subpass;
+    renderpassInfo.dependencyCount = deps.size();
+    renderpassInfo.pDependencies = deps.data();
+    VkRenderPass pass;
+    VK_CHECK(vkCreateRenderPass(device, &renderpassInfo, nullptr, &pass));
+    return pass;
+}
+void Engine::createVisibilityResources() {
+    if (!MESH_SHADERS_SUPPORTED) return;
+    createImage(visibilityImage, visibilityImageMemory, swapchainExtent.width, swapchainExtent.height, VK_FORMAT_R32G32_UINT,
+        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT);
+    createImageView(visibilityImage, visibilityImageView, VK_FORMAT_R32G32_UINT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(pDevice, depthFormat, &props);
+    visibilityDepthSampled = props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (visibilityDepthSampled) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    createImage(visibilityDepthImage, visibilityDepthImageMemory, swapchainExtent.width, swapchainExtent.height, depthFormat,
+        VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT);
+    createImageView(visibilityDepthImage, visibilityDepthImageView, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+    // the compute rasterizer's target, a 64 bit value per pixel
+    if (bufferInt64Atomics && visibilityDepthSampled) {
+        createBuffer(swVisibilityBuffer, swVisibilityBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            sizeof(uint64_t)*swapchainExtent.width*swapchainExtent.height, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+void Engine::destroyVisibilityResources() {
+    vkDestroyFramebuffer(device, visibilityFramebuffer, nullptr);
+    vkDestroyImageView(device, visibilityImageView, nullptr);
+    vkDestroyImage(device, visibilityImage, nullptr);
+    vkFreeMemory(device, visibilityImageMemory, nullptr);
+    vkDestroyImageView(device, visibilityDepthImageView, nullptr);
+    vkDestroyImage(device, visibilityDepthImage, nullptr);
+    vkFreeMemory(device, visibilityDepthImageMemory, nullptr);
+    vkDestroyBuffer(device, swVisibilityBuffer, nullptr);
+    vkFreeMemory(device, swVisibilityBufferMemory, nullptr);
+    visibilityFramebuffer = VK_NULL_HANDLE;
+    swVisibilityBuffer = VK_NULL_HANDLE;
+    swVisibilityBufferMemory = VK_NULL_HANDLE;
+}
+// with async compute the light binning is left to recordAsyncCompute
+void Engine::recordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame, bool asyncCompute) {
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.pInheritanceInfo = nullptr; // which state to inherit from primary buffer, only relevant for seconday buffers
@@ -593,104 +1153,502 @@ void Engine::recordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex,
         vkCmdResetQueryPool(cmdBuffer, queryPool, currFrame * 2, 2);
         vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currFrame * 2);
 
-        VkRenderPassBeginInfo renderpassBeginInfo{};
-        renderpassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderpassBeginInfo.renderPass = renderpass;
-        renderpassBeginInfo.framebuffer = swapchainFramebuffers[imageIndex];
-        renderpassBeginInfo.renderArea.offset = {0, 0};
-        renderpassBeginInfo.renderArea.extent = swapchainExtent;
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};
-        renderpassBeginInfo.clearValueCount = clearValues.size();
-        renderpassBeginInfo.pClearValues = clearValues.data();
-        // VK_SUBPASS_CONTENTS_INLINE: render pass commands will be embedded in the primary command buffer itself and no secondary
-        // command buffer will be executed
-        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: render pass commands will be executed from secondary command buffer
-        vkCmdBeginRenderPass(cmdBuffer, &renderpassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        {
-            if (MESH_SHADERS_ENABLED) {
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshGfxPipeline);
+        // the visibility buffer's shading pass leaves no depth to reproject with, its frames are blitted up instead
+        bool temporal = TAA_ENABLED && taaPipeline != VK_NULL_HANDLE &&
+            !(VISIBILITY_ENABLED && MESH_SHADERS_ENABLED && visibilityPipeline != VK_NULL_HANDLE);
+        taaJitter = glm::vec2(0.0f);
+        if (temporal) {
+            // 8 offsets of the Halton (2, 3) sequence, spread evenly over the pixel
+            auto halton = [](uint32_t index, uint32_t base) {
+                float fraction = 1.0f;
+                float result = 0.0f;
+                for (; index > 0; index /= base) {
+                    fraction /= base;
+                    result += fraction * (index % base);
+                }
+                return result;
+            };
+            taaFrame = (taaFrame + 1) % 8;
+            taaJitter = glm::vec2(halton(taaFrame + 1, 2), halton(taaFrame + 1, 3)) - 0.5f;
+        }
+        // steps of 1/32 keep the extent from changing by a pixel every frame
+        float scale = sceneUpscaled ? std::round(renderScale * 32.0f) / 32.0f : 1.0f;
+        renderExtent = {std::max(1u, uint32_t(swapchainExtent.width * scale)), std::max(1u, uint32_t(swapchainExtent.height * scale))};
+        frameRenderScale[currFrame] = scale;
+        updateUniformBuffers(currFrame);
+        recordCounterReset(cmdBuffer, currFrame);
+        if (lightCullPipeline != VK_NULL_HANDLE && !asyncCompute) {
+            vkCmdResetQueryPool(cmdBuffer, lightQueryPool, currFrame * 2, 2);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, lightQueryPool, currFrame * 2);
+            recordLightCull(cmdBuffer, currFrame, false);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, lightQueryPool, currFrame * 2 + 1);
+            lightCullTimed[currFrame] = true;
+        }
+        // the vertex path culls before the render pass, the mesh path draws everything
+        bool culling = CULLING_ENABLED && !MESH_SHADERS_ENABLED && cullBuffer != VK_NULL_HANDLE;
+        // with occlusion culling the frame is drawn in two passes, first what was visible last frame,
+        // then what the depth pyramid built from that can't prove to be hidden
+        bool occlusion = culling && OCCLUSION_ENABLED && depthReducePipeline != VK_NULL_HANDLE;
+        // the visibility buffer is rasterized by the mesh path, overdraw there only costs writing two ids,
+        // then every pixel is shaded exactly once
+        bool visibility = VISIBILITY_ENABLED && MESH_SHADERS_ENABLED && visibilityPipeline != VK_NULL_HANDLE;
+        // the mesh path's draws come from the level selection instead of the draw list
+        bool lod = LOD_ENABLED && MESH_SHADERS_ENABLED && lodBuffer != VK_NULL_HANDLE;
+        // with the depth prepass the scene is drawn twice over the same draws, depth only from the position stream,
+        // then shaded where the depth is equal, it takes the place of the two-pass occlusion culling
+        bool prepass = PREPASS_ENABLED && depthPrepassPipeline != VK_NULL_HANDLE;
+        if (visibility) {
+            // with hybrid rasterization the meshlets whose triangles are too small for the hardware rasterizer to
+            // be efficient at are taken out of the mesh path's draw and rasterized in compute right after it
+            bool hybrid = swRasterThreshold > 0.0f && clusterBuffer != VK_NULL_HANDLE;
+            vkCmdResetQueryPool(cmdBuffer, rasterQueryPool, currFrame * 3, 3);
+            if (hybrid) {
+                recordRasterClassify(cmdBuffer, currFrame);
+            } else if (lod) {
+                recordLodSelect(cmdBuffer, currFrame);
             } else {
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
+                buildDrawList(currFrame);
             }
-
-            // VkDeviceSize offsets[] = {0};
-            // vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, offsets);
-            vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = swapchainExtent.width;
-            viewport.height = swapchainExtent.height;
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-            VkRect2D scissor{};
-            scissor.extent = swapchainExtent;
-            scissor.offset = {0, 0};
-            vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-            updateUniformBuffers(currFrame);
-
-            PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR = 
-                (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
-            if (!vkCmdPushDescriptorSetKHR) {
-                throw std::runtime_error("Failed to load vkCmdPushDescriptorSetKHR function");
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, rasterQueryPool, currFrame * 3);
+            recordScene(cmdBuffer, imageIndex, currFrame, visibilityRenderpass, false, 0, PREPASS_NONE);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, rasterQueryPool, currFrame * 3 + 1);
+            if (hybrid) {
+                recordSoftwareRaster(cmdBuffer, currFrame);
+                vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, rasterQueryPool, currFrame * 3 + 2);
             }
-            std::vector<VkDescriptorBufferInfo> bufferInfo{};
-            std::vector<VkWriteDescriptorSet> writeDescriptorSet{};
-            if (MESH_SHADERS_ENABLED) {
-                bufferInfo.resize(2);
-                writeDescriptorSet.resize(2);
-                bufferInfo[1].buffer = meshletBuffer;
-                bufferInfo[1].offset = 0;
-                bufferInfo[1].range = meshletBufferSize;
-                writeDescriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                writeDescriptorSet[1].dstBinding = 1;
-                writeDescriptorSet[1].descriptorCount = 1;
-                writeDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                writeDescriptorSet[1].dstArrayElement = 0;
-                writeDescriptorSet[1].pBufferInfo = &bufferInfo[1];
+            rasterTimedPasses[currFrame] = hybrid ? 2 : 1;
+            recordShade(cmdBuffer, imageIndex, currFrame);
+        } else if (prepass) {
+            if (culling) {
+                recordCull(cmdBuffer, currFrame, CULL_ALL);
+            } else if (lod) {
+                recordLodSelect(cmdBuffer, currFrame);
             } else {
-                bufferInfo.resize(1);
-                writeDescriptorSet.resize(1);
+                buildDrawList(currFrame);
             }
-            writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSet[0].dstBinding = 0;
-            writeDescriptorSet[0].descriptorCount = 1;
-            writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            writeDescriptorSet[0].dstArrayElement = 0;
-            writeDescriptorSet[0].pBufferInfo = &bufferInfo[0];
-            bufferInfo[0].buffer = vertexBuffer;
-            bufferInfo[0].offset = 0;
-            bufferInfo[0].range = vertexBufferSize;
-            vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 1, 
-                MESH_SHADERS_ENABLED ? 2 : 1, writeDescriptorSet.data());
-
-            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 0, 1,
-                &descriptorSets[currFrame], 0, nullptr);
-
-            // vkCmdDraw(cmdBuffer, vertices.size(), 1, 0, 0);
-            if (MESH_SHADERS_ENABLED) {
-                PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT = 
-                    (PFN_vkCmdDrawMeshTasksEXT) vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
-                vkCmdDrawMeshTasksEXT(cmdBuffer, mesh.meshlets.size(), 1, 1);
+            vkCmdResetQueryPool(cmdBuffer, prepassQueryPool, currFrame * 3, 3);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, prepassQueryPool, currFrame * 3);
+            recordScene(cmdBuffer, imageIndex, currFrame, earlyRenderpass, culling, 0, PREPASS_DEPTH);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, prepassQueryPool, currFrame * 3 + 1);
+            recordScene(cmdBuffer, imageIndex, currFrame, lateRenderpass, culling, 0, PREPASS_SHADE);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, prepassQueryPool, currFrame * 3 + 2);
+            prepassTimed[currFrame] = true;
+        } else if (occlusion) {
+            recordCull(cmdBuffer, currFrame, CULL_EARLY);
+            recordScene(cmdBuffer, imageIndex, currFrame, earlyRenderpass, true, 0, PREPASS_NONE);
+            recordDepthPyramid(cmdBuffer);
+            recordCull(cmdBuffer, currFrame, CULL_LATE);
+            recordScene(cmdBuffer, imageIndex, currFrame, lateRenderpass, true, 1, PREPASS_NONE);
+        } else {
+            if (culling) {
+                recordCull(cmdBuffer, currFrame, CULL_ALL);
+            } else if (lod) {
+                recordLodSelect(cmdBuffer, currFrame);
             } else {
-                vkCmdDrawIndexed(cmdBuffer, mesh.indices.size(), 1, 0, 0, 0);
+                buildDrawList(currFrame);
             }
+            recordScene(cmdBuffer, imageIndex, currFrame, renderpass, culling, 0, PREPASS_NONE);
+        }
+        recordCounterReadback(cmdBuffer, currFrame);
+        if (temporal) {
+            recordTemporalUpscale(cmdBuffer, imageIndex);
+        } else if (sceneUpscaled) {
+            historyValid = false;
+            recordUpscale(cmdBuffer, imageIndex, sceneImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderExtent);
         }
-        vkCmdEndRenderPass(cmdBuffer);
         vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currFrame * 2 + 1);
     }
     VK_CHECK(vkEndCommandBuffer(cmdBuffer));
 
 }
+// the compute queue's part of a frame, the light binning with its timestamps, the uniform buffer it reads was
+// written by recordCommandBuffer before either is submitted
+void Engine::recordAsyncCompute(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+    vkCmdResetQueryPool(cmdBuffer, lightQueryPool, currFrame * 2, 2);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, lightQueryPool, currFrame * 2);
+    recordLightCull(cmdBuffer, currFrame, true);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, lightQueryPool, currFrame * 2 + 1);
+    VK_CHECK(vkEndCommandBuffer(cmdBuffer));
+    lightCullTimed[currFrame] = true;
+    asyncComputeTimed[currFrame] = true;
+}
+// one render pass over the scene, culled draws come from the given list of the cull pass, the prepass stage picks
+// the depth only or the depth equal pipelines
+void Engine::recordScene(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame, VkRenderPass pass, bool culled, uint32_t drawList,
+        DepthPrepass prepass) {
+    // the visibility pass draws the same way, only into its own target with its own mesh pipeline
+    bool visibility = pass == visibilityRenderpass;
+    // the hybrid rasterizer's classification left the mesh path a list of clusters instead of the draw list
+    bool clusters = visibility && swRasterThreshold > 0.0f && clusterBuffer != VK_NULL_HANDLE;
+    // otherwise the level selection may have left the mesh path its draws
+    bool lod = !culled && !clusters && LOD_ENABLED && MESH_SHADERS_ENABLED && lodBuffer != VK_NULL_HANDLE;
+    VkPipeline vertexPipeline = prepass == PREPASS_DEPTH ? depthPrepassPipeline :
+        prepass == PREPASS_SHADE ? gfxEqualPipeline : gfxPipeline;
+    VkPipeline meshPipeline = visibility ? visibilityPipeline : prepass == PREPASS_DEPTH ? meshDepthPrepassPipeline :
+        prepass == PREPASS_SHADE ? meshEqualPipeline : meshGfxPipeline;
+    VkRenderPassBeginInfo renderpassBeginInfo{};
+    renderpassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpassBeginInfo.renderPass = pass;
+    renderpassBeginInfo.framebuffer = visibility ? visibilityFramebuffer : swapchainFramebuffers[imageIndex];
+    renderpassBeginInfo.renderArea.offset = {0, 0};
+    renderpassBeginInfo.renderArea.extent = renderExtent;
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    if (visibility) clearValues[0].color.uint32[0] = ~0u; // no triangle
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderpassBeginInfo.clearValueCount = clearValues.size();
+    renderpassBeginInfo.pClearValues = clearValues.data();
+    // VK_SUBPASS_CONTENTS_INLINE: render pass commands will be embedded in the primary command buffer itself and no secondary
+    // command buffer will be executed
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: render pass commands will be executed from secondary command buffer
+    vkCmdBeginRenderPass(cmdBuffer, &renderpassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    {
+        // the pipeline is bound once for the culled draws, the draw list binds it per call when the state changes
+        if (culled) {
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vertexPipeline);
+        }
+
+        // VkDeviceSize offsets[] = {0};
+        // vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, offsets);
+        vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, indexType);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = renderExtent.width;
+        viewport.height = renderExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+        VkRect2D scissor{};
+        scissor.extent = renderExtent;
+        scissor.offset = {0, 0};
+        vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+        PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR = 
+            (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+        if (!vkCmdPushDescriptorSetKHR) {
+            throw std::runtime_error("Failed to load vkCmdPushDescriptorSetKHR function");
+        }
+        // positions, attributes, instances and the order they are drawn in, then for mesh shaders the headers,
+        // vertex stream and triangle stream, which are sections of the same buffer, the draws and the counters
+        std::vector<VkDescriptorBufferInfo> bufferInfo = {
+            {positionBuffer, 0, positionBufferSize},
+            {attributeBuffer, 0, attributeBufferSize},
+            {instanceBuffer, 0, sizeof(Instance)*instances.size()},
+        };
+        if (culled || clusters) {
+            bufferInfo.push_back({drawBuffer, instanceOrderRange.offset, instanceOrderRange.size});
+        } else if (lod) {
+            bufferInfo.push_back({lodBuffer, lodOrderRange.offset, lodOrderRange.size});
+        } else {
+            bufferInfo.push_back({drawListBuffers[currFrame], drawListOrderRange.offset, drawListOrderRange.size});
+        }
+        if (MESH_SHADERS_ENABLED) {
+            bufferInfo.push_back({meshletBuffer, meshletHeaderRange.offset, meshletHeaderRange.size});
+            bufferInfo.push_back({meshletBuffer, meshletVertexRange.offset, meshletVertexRange.size});
+            bufferInfo.push_back({meshletBuffer, meshletTriangleRange.offset, meshletTriangleRange.size});
+            if (clusters) {
+                bufferInfo.push_back({clusterBuffer, 0, sizeof(glm::uvec2)*cullDrawCapacity});
+            } else if (lod) {
+                bufferInfo.push_back({lodBuffer, lodCommandRange.offset, lodCommandRange.size});
+            } else {
+                bufferInfo.push_back({drawListBuffers[currFrame], drawListCommandRange.offset, drawListCommandRange.size});
+            }
+            bufferInfo.push_back({counterBuffer, counterStride*currFrame, sizeof(PipelineCounters)});
+        }
+        std::vector<VkWriteDescriptorSet> writeDescriptorSet(bufferInfo.size());
+        for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+            writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet[i].dstBinding = i;
+            writeDescriptorSet[i].descriptorCount = 1;
+            writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSet[i].dstArrayElement = 0;
+            writeDescriptorSet[i].pBufferInfo = &bufferInfo[i];
+        }
+        vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 1, 
+            writeDescriptorSet.size(), writeDescriptorSet.data());
+
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 0, 1,
+            &descriptorSets[currFrame], 0, nullptr);
+
+        // vkCmdDraw(cmdBuffer, vertices.size(), 1, 0, 0);
+        if (MESH_SHADERS_ENABLED) {
+            // the small triangle test needs to know where samples are, the standard locations of up to 8 samples
+            // sit at the centers of a grid with as many cells per pixel and axis as there are samples
+            MeshConstants constants{};
+            constants.cullTriangles = TRIANGLE_CULLING_ENABLED;
+            constants.clusterList = clusters;
+            VkSampleCountFlagBits samples = visibility ? VK_SAMPLE_COUNT_1_BIT : msaaSamples;
+            if (standardSampleLocations && samples <= VK_SAMPLE_COUNT_8_BIT) {
+                constants.sampleGrid = glm::vec2(renderExtent.width, renderExtent.height) * float(samples);
+            }
+            vkCmdPushConstants(cmdBuffer, gfxPipelineLayout, VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(constants), &constants);
+        }
+        PFN_vkCmdDrawMeshTasksIndirectEXT vkCmdDrawMeshTasksIndirectEXT =
+            (PFN_vkCmdDrawMeshTasksIndirectEXT) vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksIndirectEXT");
+        if (culled) {
+            // a draw per meshlet and instance
+            vkCmdDrawIndexedIndirectCount(cmdBuffer, visibleDrawBuffer, sizeof(VkDrawIndexedIndirectCommand)*cullDrawCapacity*drawList,
+                drawCountBuffer, sizeof(uint32_t)*drawList, cullDrawCapacity, sizeof(VkDrawIndexedIndirectCommand));
+        } else if (clusters) {
+            // as many workgroups as the classification counted
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+            vkCmdDrawMeshTasksIndirectEXT(cmdBuffer, rasterCommandBuffer, 0, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+        } else if (lod) {
+            // a draw per batch of every level, the ones no instance picked have no workgroups
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+            vkCmdDrawMeshTasksIndirectEXT(cmdBuffer, lodBuffer, lodCommandRange.offset, lodCommandCount, sizeof(MeshTaskDraw));
+        } else if (MESH_SHADERS_ENABLED && options.gpuMeshlets && instances.size() == 1) {
+            // the build wrote the number of meshlets into the draw, it never has to come back to the CPU
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+            vkCmdDrawMeshTasksIndirectEXT(cmdBuffer, meshletCountBuffer, 0, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+        } else {
+            // one indirect call per state, there is a single material so only the pipeline is ever bound
+            uint32_t boundPipeline = ~0u;
+            for (const auto& call: drawCalls) {
+                uint32_t pipeline = drawStatePipeline(call.state);
+                if (pipeline != boundPipeline) {
+                    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline ? meshPipeline : vertexPipeline);
+                    boundPipeline = pipeline;
+                }
+                VkDeviceSize offset = drawListCommandRange.offset;
+                if (pipeline) {
+                    vkCmdDrawMeshTasksIndirectEXT(cmdBuffer, drawListBuffers[currFrame], offset + sizeof(MeshTaskDraw)*call.firstCommand,
+                        call.commandCount, sizeof(MeshTaskDraw));
+                } else {
+                    vkCmdDrawIndexedIndirect(cmdBuffer, drawListBuffers[currFrame], offset + sizeof(VkDrawIndexedIndirectCommand)*call.firstCommand,
+                        call.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
+        }
+    }
+    vkCmdEndRenderPass(cmdBuffer);
+}
+// the forward render pass with a single fullscreen triangle that shades from the visibility buffer
+void Engine::recordShade(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame) {
+    VkRenderPassBeginInfo renderpassBeginInfo{};
+    renderpassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpassBeginInfo.renderPass = renderpass;
+    renderpassBeginInfo.framebuffer = swapchainFramebuffers[imageIndex];
+    renderpassBeginInfo.renderArea.offset = {0, 0};
+    renderpassBeginInfo.renderArea.extent = renderExtent;
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderpassBeginInfo.clearValueCount = clearValues.size();
+    renderpassBeginInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(cmdBuffer, &renderpassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadePipeline);
+        VkViewport viewport{};
+        viewport.width = renderExtent.width;
+        viewport.height = renderExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+        VkRect2D scissor{};
+        scissor.extent = renderExtent;
+        vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+        std::array<VkDescriptorBufferInfo, 6> bufferInfo = {{
+            {positionBuffer, 0, positionBufferSize},
+            {attributeBuffer, 0, attributeBufferSize},
+            {instanceBuffer, 0, sizeof(Instance)*instances.size()},
+            {meshletBuffer, meshletHeaderRange.offset, meshletHeaderRange.size},
+            {meshletBuffer, meshletVertexRange.offset, meshletVertexRange.size},
+            {meshletBuffer, meshletTriangleRange.offset, meshletTriangleRange.size},
+        }};
+        VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, visibilityImageView, VK_IMAGE_LAYOUT_GENERAL};
+        std::array<VkWriteDescriptorSet, 7> writeDescriptorSet{};
+        for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+            writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet[i].dstBinding = i;
+            writeDescriptorSet[i].descriptorCount = 1;
+            writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSet[i].pBufferInfo = i < bufferInfo.size() ? &bufferInfo[i] : nullptr;
+        }
+        writeDescriptorSet[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet[6].pImageInfo = &imageInfo;
+        PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+            (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+        vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadePipelineLayout, 1,
+            writeDescriptorSet.size(), writeDescriptorSet.data());
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadePipelineLayout, 0, 1,
+            &descriptorSets[currFrame], 0, nullptr);
+        vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    }
+    vkCmdEndRenderPass(cmdBuffer);
+}
+// stretches the extent of the image over the swapchain image, the first barrier chains with the acquire semaphore's
+// wait at color attachment output
+void Engine::recordUpscale(VkCommandBuffer cmdBuffer, uint32_t imageIndex, VkImage image, VkImageLayout layout, VkExtent2D extent) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapchainImages[imageIndex];
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {int32_t(extent.width), int32_t(extent.height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {int32_t(swapchainExtent.width), int32_t(swapchainExtent.height), 1};
+    vkCmdBlitImage(cmdBuffer, image, layout, swapchainImages[imageIndex],
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+}
+// the frame that last used this slot is done, its GPU time against the budget moves the scale, the cost of a frame
+// goes roughly with its pixels, so the scale per axis with the square root of the ratio, damped as the frames in
+// flight were recorded at older scales
+void Engine::updateRenderScale(uint32_t currFrame) {
+    float measuredScale = frameRenderScale[currFrame];
+    frameRenderScale[currFrame] = 0.0f;
+    if (!DYNAMIC_RESOLUTION_ENABLED) {
+        renderScale = options.renderScale;
+        return;
+    }
+    if (measuredScale == 0.0f) return;
+    uint64_t timestamps[2];
+    vkGetQueryPoolResults(device, queryPool, currFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    double gpuTimeMs = std::max((timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0, 1e-3);
+    float target = measuredScale * std::sqrt(options.frameBudget / gpuTimeMs);
+    renderScale = std::clamp(renderScale + (target - renderScale) * 0.25f, MIN_RENDER_SCALE, 1.0f);
+}
+// accumulates the frame into the history written next and blits that into the swapchain image, the history the
+// last frame wrote is read where every pixel was back then
+void Engine::recordTemporalUpscale(VkCommandBuffer cmdBuffer, uint32_t imageIndex) {
+    VkImageAspectFlags depthAspect = depthFormat == VK_FORMAT_D32_SFLOAT ?
+        VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    // the render pass' outgoing dependency made the resolve visible to transfer, the histories start out undefined
+    std::array<VkImageMemoryBarrier, 4> barriers{};
+    for (auto& barrier: barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+    barriers[0].srcAccessMask = 0;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].image = sceneImage;
+    barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].image = depthImage;
+    barriers[1].subresourceRange.aspectMask = depthAspect;
+    for (uint32_t i=0; i<historyImages.size(); i++) {
+        // transfer covers the last frame's blit still reading the one written now
+        barriers[2 + i].srcAccessMask = historyValid ? VK_ACCESS_SHADER_WRITE_BIT : 0;
+        barriers[2 + i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[2 + i].oldLayout = historyValid ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[2 + i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[2 + i].image = historyImages[i];
+    }
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        barriers.size(), barriers.data());
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, taaPipeline);
+    std::array<VkDescriptorImageInfo, 4> imageInfo{};
+    imageInfo[0] = {depthPyramidSampler, sceneImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    imageInfo[1] = {depthPyramidSampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    imageInfo[2] = {taaSampler, historyImageViews[historyIndex ^ 1], VK_IMAGE_LAYOUT_GENERAL};
+    imageInfo[3] = {VK_NULL_HANDLE, historyImageViews[historyIndex], VK_IMAGE_LAYOUT_GENERAL};
+    std::array<VkWriteDescriptorSet, 4> writeDescriptorSet{};
+    for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].dstBinding = i;
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writeDescriptorSet[i].pImageInfo = &imageInfo[i];
+    }
+    writeDescriptorSet[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, taaPipelineLayout, 0,
+        writeDescriptorSet.size(), writeDescriptorSet.data());
+
+    // the scene only moves with ubo.model, so a pixel's depth takes it back to where it was
+    TaaConstants constants{};
+    constants.reprojection = previousClip * glm::inverse(frameClip);
+    constants.jitter = taaJitter;
+    constants.renderSize = glm::vec2(renderExtent.width, renderExtent.height);
+    constants.outputSize = glm::vec2(swapchainExtent.width, swapchainExtent.height);
+    constants.blend = 0.1f;
+    constants.reset = !historyValid;
+    vkCmdPushConstants(cmdBuffer, taaPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmdBuffer, (swapchainExtent.width + 7)/8, (swapchainExtent.height + 7)/8, 1);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+    recordUpscale(cmdBuffer, imageIndex, historyImages[historyIndex], VK_IMAGE_LAYOUT_GENERAL, swapchainExtent);
+    previousClip = frameClip;
+    historyIndex ^= 1;
+    historyValid = true;
+}
 void Engine::cleanupSwapchain() {
+    destroyDepthPyramid();
+    destroyVisibilityResources();
     vkDestroyImageView(device, colorImageView, nullptr);
     vkDestroyImage(device, colorImage, nullptr);
     vkFreeMemory(device, colorImageMemory, nullptr);
+    colorImageView = VK_NULL_HANDLE;
+    colorImage = VK_NULL_HANDLE;
+    colorImageMemory = VK_NULL_HANDLE;
+    vkDestroyImageView(device, sceneImageView, nullptr);
+    vkDestroyImage(device, sceneImage, nullptr);
+    vkFreeMemory(device, sceneImageMemory, nullptr);
+    sceneImageView = VK_NULL_HANDLE;
+    sceneImage = VK_NULL_HANDLE;
+    sceneImageMemory = VK_NULL_HANDLE;
+    for (uint32_t i=0; i<historyImages.size(); i++) {
+        vkDestroyImageView(device, historyImageViews[i], nullptr);
+        vkDestroyImage(device, historyImages[i], nullptr);
+        vkFreeMemory(device, historyImageMemory[i], nullptr);
+        historyImageViews[i] = VK_NULL_HANDLE;
+        historyImages[i] = VK_NULL_HANDLE;
+        historyImageMemory[i] = VK_NULL_HANDLE;
+    }
     vkDestroyImageView(device, depthImageView, nullptr);
     vkDestroyImage(device, depthImage, nullptr);
     vkFreeMemory(device, depthImageMemory, nullptr);
@@ -703,30 +1661,99 @@ void Engine::cleanupSwapchain() {
     vkDestroySwapchainKHR(device, swapchain, nullptr);
 }
 void Engine::createVertexBuffer() {
-    vertexBufferSize = sizeof(mesh.vertices[0])*mesh.vertices.size();
+    // the vertices go up de-interleaved, so a pass that only needs positions fetches half the bytes
+    splitVertexStreams(mesh, 0, mesh.vertices.size());
+    positionBufferSize = sizeof(VertexPosition)*mesh.positions.size();
+    attributeBufferSize = sizeof(VertexAttributes)*mesh.attributes.size();
+    struct Stream {
+        VkBuffer& buffer;
+        VkDeviceMemory& memory;
+        const void* data;
+        VkDeviceSize size;
+    };
+    for (Stream stream: {Stream{positionBuffer, positionBufferMemory, mesh.positions.data(), positionBufferSize},
+            Stream{attributeBuffer, attributeBufferMemory, mesh.attributes.data(), attributeBufferSize}}) {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT here means GPU keeps track of writes to this buffer
+        // if the writes are done to cache or they are not done yet, GPU will take it into account
+        // without this flag we have to manually flush writes
+        createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stream.size,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, stream.size, 0, &data);
+        memcpy(data, stream.data, stream.size);
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        createBuffer(stream.buffer, stream.memory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, stream.size,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        copyBuffer(stagingBuffer, stream.buffer, stream.size);
+
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+    }
+}
+void Engine::createInstanceBuffer() {
+    // every mesh gets a consecutive run of the instances, at least one
+    generateInstances(instances, std::max<uint32_t>(options.instances, meshRanges.size()));
+    uint32_t firstInstance = 0;
+    for (size_t m=0; m<meshRanges.size(); m++) {
+        meshRanges[m].firstInstance = firstInstance;
+        meshRanges[m].instanceCount = instances.size()/meshRanges.size() + (m < instances.size()%meshRanges.size() ? 1 : 0);
+        firstInstance += meshRanges[m].instanceCount;
+    }
+    VkDeviceSize size = sizeof(Instance)*instances.size();
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
-    // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT here means GPU keeps track of writes to this buffer
-    // if the writes are done to cache or they are not done yet, GPU will take it into account
-    // without this flag we have to manually flush writes
-    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vertexBufferSize, 
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    
     void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, vertexBufferSize, 0, &data);
-    memcpy(data, mesh.vertices.data(), vertexBufferSize);
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, instances.data(), size);
     vkUnmapMemory(device, stagingBufferMemory);
 
-    createBuffer(vertexBuffer, vertexBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertexBufferSize, 
+    createBuffer(instanceBuffer, instanceBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    copyBuffer(stagingBuffer, vertexBuffer, vertexBufferSize);
-
+    copyBuffer(stagingBuffer, instanceBuffer, size);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
     vkDestroyBuffer(device, stagingBuffer, nullptr);
 }
 void Engine::createIndexBuffer() {
-    VkDeviceSize size = sizeof(mesh.indices[0])*mesh.indices.size();
+    // the GPU meshlet build reads 32 bit indices in the original order, so it never gets the meshlet order
+    // the pool's indices already point at pool vertices, so every mesh is one group
+    std::vector<uint16_t> meshletIndices;
+    indexType = VK_INDEX_TYPE_UINT32;
+    indexGroups.clear();
+    meshGroupOffsets.clear();
+    for (const auto& range: meshRanges) {
+        meshGroupOffsets.push_back(indexGroups.size());
+        indexGroups.push_back({range.indexOffset, range.indexCount, 0});
+    }
+    meshGroupOffsets.push_back(indexGroups.size());
+    if (options.meshletIndices && !options.gpuMeshlets) {
+        // groups are cut at mesh boundaries, so a mesh's draws are its own
+        std::vector<MeshletIndexGroup> groups;
+        std::vector<uint32_t> groupOffsets;
+        bool fits = true;
+        for (const auto& range: meshRanges) {
+            groupOffsets.push_back(groups.size());
+            fits = fits && appendMeshletIndices(mesh, range.meshletOffset, range.meshletOffset + range.meshletCount, meshletIndices, groups);
+        }
+        groupOffsets.push_back(groups.size());
+        if (fits) {
+            indexType = VK_INDEX_TYPE_UINT16;
+            indexGroups = groups;
+            meshGroupOffsets = groupOffsets;
+            std::cout << "Index buffer: meshlet order, 16 bit, " << groups.size() << " draws" << std::endl;
+        } else {
+            meshletIndices.clear();
+            std::cout << "Index buffer: a meshlet spans more than 16 bits of vertices, keeping 32 bit indices" << std::endl;
+        }
+    }
+    const void* indexData = indexType == VK_INDEX_TYPE_UINT16 ? (const void*)meshletIndices.data() : (const void*)mesh.indices.data();
+    VkDeviceSize size = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t)*meshletIndices.size() : sizeof(uint32_t)*mesh.indices.size();
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, 
@@ -734,10 +1761,12 @@ void Engine::createIndexBuffer() {
     
     void* data;
     vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
-    memcpy(data, mesh.indices.data(), size);
+    memcpy(data, indexData, size);
     vkUnmapMemory(device, stagingBufferMemory);
 
-    createBuffer(indexBuffer, indexBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, size, 
+    // storage as well, the GPU meshlet build reads it
+    createBuffer(indexBuffer, indexBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size, 
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     copyBuffer(stagingBuffer, indexBuffer, size);
@@ -746,7 +1775,23 @@ void Engine::createIndexBuffer() {
     vkDestroyBuffer(device, stagingBuffer, nullptr);
 }
 void Engine::createMeshletBuffer() {
-    meshletBufferSize = sizeof(mesh.meshlets[0])*mesh.meshlets.size();
+    // headers, vertex stream and triangle stream share one buffer, each section is bound
+    // as its own storage buffer so it has to start at an offset the device can bind
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    VkDeviceSize alignment = props.limits.minStorageBufferOffsetAlignment;
+    if (options.gpuMeshlets) {
+        createGpuMeshlets(alignment);
+        return;
+    }
+    meshletHeaderRange.offset = 0;
+    meshletHeaderRange.size = sizeof(mesh.meshlets[0])*mesh.meshlets.size();
+    meshletVertexRange.offset = alignUp(meshletHeaderRange.offset + meshletHeaderRange.size, alignment);
+    meshletVertexRange.size = sizeof(mesh.meshletVertices[0])*mesh.meshletVertices.size();
+    meshletTriangleRange.offset = alignUp(meshletVertexRange.offset + meshletVertexRange.size, alignment);
+    meshletTriangleRange.size = sizeof(mesh.meshletTriangles[0])*mesh.meshletTriangles.size();
+    meshletBufferSize = meshletTriangleRange.offset + meshletTriangleRange.size;
+
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, meshletBufferSize, 
@@ -754,7 +1799,9 @@ void Engine::createMeshletBuffer() {
     
     void* data;
     vkMapMemory(device, stagingBufferMemory, 0, meshletBufferSize, 0, &data);
-    memcpy(data, mesh.meshlets.data(), meshletBufferSize);
+    memcpy((char*)data + meshletHeaderRange.offset, mesh.meshlets.data(), meshletHeaderRange.size);
+    memcpy((char*)data + meshletVertexRange.offset, mesh.meshletVertices.data(), meshletVertexRange.size);
+    memcpy((char*)data + meshletTriangleRange.offset, mesh.meshletTriangles.data(), meshletTriangleRange.size);
     vkUnmapMemory(device, stagingBufferMemory);
 
     createBuffer(meshletBuffer, meshletBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBufferSize, 
@@ -765,25 +1812,1202 @@ void Engine::createMeshletBuffer() {
     vkFreeMemory(device, stagingBufferMemory, nullptr);
     vkDestroyBuffer(device, stagingBuffer, nullptr);
 }
+void Engine::createGpuMeshlets(VkDeviceSize alignment) {
+    // the streams are sized for the worst case, the build only knows how much it used once it ran:
+    // up to 4 meshlets per window of 64 triangles, 3 vertices per triangle and 18 bits per triangle
+    // plus a partially used word per meshlet
+    uint32_t triangleCount = mesh.indices.size()/3;
+    uint32_t windowCount = (triangleCount + 63)/64;
+    meshletHeaderRange.offset = 0;
+    meshletHeaderRange.size = sizeof(Meshlet)*4*windowCount;
+    meshletVertexRange.offset = alignUp(meshletHeaderRange.offset + meshletHeaderRange.size, alignment);
+    meshletVertexRange.size = sizeof(uint32_t)*3*triangleCount;
+    meshletTriangleRange.offset = alignUp(meshletVertexRange.offset + meshletVertexRange.size, alignment);
+    meshletTriangleRange.size = sizeof(uint32_t)*((uint64_t(triangleCount)*MESHLET_TRIANGLE_BITS + 31)/32 + 4*windowCount);
+    meshletBufferSize = meshletTriangleRange.offset + meshletTriangleRange.size;
+    createBuffer(meshletBuffer, meshletBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBufferSize,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // host visible so the meshlet count can be shown without a copy, it's only 5 words
+    createBuffer(meshletCountBuffer, meshletCountBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(uint32_t)*5, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    VkCommandPool cmdPool = createCommandPool(queueFamilies.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    VkCommandBuffer cmdBuffer = createCommandBuffer(cmdPool);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+    recordMeshletBuild(cmdBuffer);
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &cmdBuffer;
+
+    VkFence fence = createFence(0);
+    vkQueueSubmit(graphicsQueue, 1, &info, fence);
+    vkWaitForFences(device, 1, &fence, VK_TRUE, ~0ull);
+    vkDestroyCommandPool(device, cmdPool, nullptr);
+    vkDestroyFence(device, fence, nullptr);
+
+    uint32_t* counters;
+    vkMapMemory(device, meshletCountBufferMemory, 0, sizeof(uint32_t)*5, 0, (void**)&counters);
+    gpuMeshletCount = counters[0];
+    size_t usedSize = sizeof(Meshlet)*counters[0] + sizeof(uint32_t)*(counters[3] + counters[4]);
+    vkUnmapMemory(device, meshletCountBufferMemory);
+    std::cout << "GPU meshlets: " << gpuMeshletCount << ", " << usedSize << " bytes used of " << meshletBufferSize << std::endl;
+}
+void Engine::recordMeshletBuild(VkCommandBuffer cmdBuffer) {
+    // the triangle stream is OR-ed into, so it starts cleared, the counters start with an empty draw
+    vkCmdFillBuffer(cmdBuffer, meshletBuffer, meshletTriangleRange.offset, meshletTriangleRange.size, 0);
+    uint32_t counters[5] = {0, 1, 1, 0, 0};
+    vkCmdUpdateBuffer(cmdBuffer, meshletCountBuffer, 0, sizeof(counters), counters);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletBuildPipeline);
+    std::array<VkDescriptorBufferInfo, 5> bufferInfo{};
+    bufferInfo[0] = {indexBuffer, 0, sizeof(mesh.indices[0])*mesh.indices.size()};
+    bufferInfo[1] = {meshletBuffer, meshletHeaderRange.offset, meshletHeaderRange.size};
+    bufferInfo[2] = {meshletBuffer, meshletVertexRange.offset, meshletVertexRange.size};
+    bufferInfo[3] = {meshletBuffer, meshletTriangleRange.offset, meshletTriangleRange.size};
+    bufferInfo[4] = {meshletCountBuffer, 0, sizeof(counters)};
+    std::array<VkWriteDescriptorSet, 5> writeDescriptorSet{};
+    for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].dstBinding = i;
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet[i].pBufferInfo = &bufferInfo[i];
+    }
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletBuildPipelineLayout, 0,
+        writeDescriptorSet.size(), writeDescriptorSet.data());
+    uint32_t triangleCount = mesh.indices.size()/3;
+    vkCmdPushConstants(cmdBuffer, meshletBuildPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(triangleCount), &triangleCount);
+
+    // one workgroup per window of 64 triangles, spread over y when x runs out
+    uint32_t windowCount = (triangleCount + 63)/64;
+    uint32_t groupCountX = std::min(windowCount, 65535u);
+    uint32_t groupCountY = (windowCount + groupCountX - 1)/std::max(groupCountX, 1u);
+    vkCmdDispatch(cmdBuffer, groupCountX, groupCountY, 1);
+
+    // the meshlets are read by the mesh shader, the counters by the indirect draw and the host
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+void Engine::editVertices(uint32_t firstVertex, const std::vector<Vertex>& vertices) {
+    if (size_t(firstVertex) + vertices.size() > mesh.vertices.size()) {
+        throw std::runtime_error("vertex edit out of range");
+    }
+    std::copy(vertices.begin(), vertices.end(), mesh.vertices.begin() + firstVertex);
+    dirtyVertices.push_back({firstVertex, firstVertex + vertices.size()});
+}
+void Engine::editTriangles(uint32_t firstTriangle, const std::vector<uint32_t>& indices) {
+    if (indices.size() % 3 != 0 || size_t(firstTriangle)*3 + indices.size() > mesh.indices.size()) {
+        throw std::runtime_error("triangle edit out of range");
+    }
+    for (uint32_t index: indices) {
+        if (index >= mesh.vertices.size()) throw std::runtime_error("triangle edit uses a vertex that doesn't exist");
+    }
+    std::copy(indices.begin(), indices.end(), mesh.indices.begin() + size_t(firstTriangle)*3);
+    dirtyTriangles.push_back({firstTriangle, firstTriangle + indices.size()/3});
+}
+// sorts the ranges and joins the ones that overlap or touch
+static void mergeRanges(std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i=0; i<ranges.size(); i++) {
+        if (merged > 0 && ranges[i].first <= ranges[merged-1].second) {
+            ranges[merged-1].second = std::max(ranges[merged-1].second, ranges[i].second);
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    ranges.resize(merged);
+}
+void Engine::flushMeshEdits() {
+    if (dirtyVertices.empty() && dirtyTriangles.empty()) return;
+    mergeRanges(dirtyVertices);
+    mergeRanges(dirtyTriangles);
+
+    // only the meshlets around the edited triangles are redone, moved vertices just change bounds
+    MeshletUpdate update;
+    if (!options.gpuMeshlets) {
+        for (const auto& [first, last]: dirtyTriangles) rebuildMeshlets(mesh, first, last, update);
+        for (const auto& [first, last]: dirtyVertices) updateMeshletBounds(mesh, first, last);
+    }
+
+    // the frames in flight read the buffers that are about to change, their fences also cover the async compute
+    // work, which the graphics submit of the same frame waits for
+    if (!cmdBufferReady.empty()) vkWaitForFences(device, cmdBufferReady.size(), cmdBufferReady.data(), VK_TRUE, ~0ull);
+    if (update.resized) {
+        // the meshlets moved, the whole meshlet buffer goes up again
+        vkDestroyBuffer(device, meshletBuffer, nullptr);
+        vkFreeMemory(device, meshletBufferMemory, nullptr);
+        createMeshletBuffer();
+        update.meshlets.clear();
+        update.vertexWords.clear();
+        update.triangleWords.clear();
+    }
+
+    // edits need a pool of one mesh, which now may have a different number of meshlets
+    meshRanges[0].meshletCount = mesh.meshlets.size();
+
+    // every changed range becomes one copy out of a shared staging buffer
+    struct Upload {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        const void* data;
+        VkDeviceSize size;
+    };
+    std::vector<Upload> uploads;
+    // a copy region of size 0 is invalid, an edit of no vertices or triangles leaves one behind
+    auto upload = [&](VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+        if (size > 0) uploads.push_back({buffer, offset, data, size});
+    };
+    for (const auto& [first, last]: dirtyVertices) {
+        if (first == last) continue;
+        splitVertexStreams(mesh, first, last);
+        upload(positionBuffer, sizeof(VertexPosition)*first, &mesh.positions[first], sizeof(VertexPosition)*(last - first));
+        upload(attributeBuffer, sizeof(VertexAttributes)*first, &mesh.attributes[first], sizeof(VertexAttributes)*(last - first));
+    }
+    if (indexType == VK_INDEX_TYPE_UINT16 && !dirtyTriangles.empty()) {
+        // meshlet ordered indices move with the meshlets, they are written out again as a whole
+        vkDestroyBuffer(device, indexBuffer, nullptr);
+        vkFreeMemory(device, indexBufferMemory, nullptr);
+        createIndexBuffer();
+    } else {
+        for (const auto& [first, last]: dirtyTriangles) {
+            if (first == last) continue;
+            upload(indexBuffer, sizeof(uint32_t)*3*first, &mesh.indices[size_t(first)*3], sizeof(uint32_t)*3*(last - first));
+        }
+    }
+    if (cullBuffer != VK_NULL_HANDLE) {
+        // draws and bounds follow the meshlets and the index groups, they are few compared to the streams, so they go up whole
+        uint32_t capacity = cullDrawCapacity;
+        destroyCullBuffers();
+        createCullBuffers();
+        // the hybrid rasterizer's clusters are sized by the cull capacity
+        if (cullDrawCapacity != capacity) {
+            destroyRasterBuffers();
+            createRasterBuffers();
+        }
+    }
+    for (const auto& [first, last]: update.meshlets) {
+        if (first == last) continue;
+        upload(meshletBuffer, meshletHeaderRange.offset + sizeof(Meshlet)*first, &mesh.meshlets[first], sizeof(Meshlet)*(last - first));
+    }
+    for (const auto& [first, last]: update.vertexWords) {
+        if (first == last) continue;
+        upload(meshletBuffer, meshletVertexRange.offset + sizeof(uint32_t)*first, &mesh.meshletVertices[first], sizeof(uint32_t)*(last - first));
+    }
+    for (const auto& [first, last]: update.triangleWords) {
+        if (first == last) continue;
+        upload(meshletBuffer, meshletTriangleRange.offset + sizeof(uint32_t)*first, &mesh.meshletTriangles[first], sizeof(uint32_t)*(last - first));
+    }
+    bool gpuBuild = options.gpuMeshlets && !dirtyTriangles.empty();
+    if (uploads.empty() && !gpuBuild) {
+        destroyDrawBuffers();
+        createDrawBuffers();
+        dirtyVertices.clear();
+        dirtyTriangles.clear();
+        return;
+    }
+    VkDeviceSize stagingSize = 0;
+    for (const auto& upload: uploads) stagingSize += upload.size;
+
+    // a buffer can't be empty, a GPU build without copies still gets one
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, std::max<VkDeviceSize>(stagingSize, 4),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    char* data;
+    vkMapMemory(device, stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+    VkDeviceSize stagingOffset = 0;
+    for (const auto& upload: uploads) {
+        memcpy(data + stagingOffset, upload.data, upload.size);
+        stagingOffset += upload.size;
+    }
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    // graphics queue, the GPU meshlet build has to run after the copies
+    VkCommandPool cmdPool = createCommandPool(queueFamilies.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    VkCommandBuffer cmdBuffer = createCommandBuffer(cmdPool);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+    stagingOffset = 0;
+    for (const auto& upload: uploads) {
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = upload.offset;
+        region.size = upload.size;
+        vkCmdCopyBuffer(cmdBuffer, stagingBuffer, upload.buffer, 1, &region);
+        stagingOffset += upload.size;
+    }
+    if (gpuBuild) {
+        // the build's first barrier also covers the index copies above
+        recordMeshletBuild(cmdBuffer);
+    }
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &cmdBuffer;
+    VkFence fence = createFence(0);
+    vkQueueSubmit(graphicsQueue, 1, &info, fence);
+    vkWaitForFences(device, 1, &fence, VK_TRUE, ~0ull);
+    vkDestroyCommandPool(device, cmdPool, nullptr);
+    vkDestroyFence(device, fence, nullptr);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+
+    if (gpuBuild) {
+        uint32_t* counters;
+        vkMapMemory(device, meshletCountBufferMemory, 0, sizeof(uint32_t), 0, (void**)&counters);
+        gpuMeshletCount = counters[0];
+        vkUnmapMemory(device, meshletCountBufferMemory);
+    }
+    destroyDrawBuffers();
+    createDrawBuffers();
+    dirtyVertices.clear();
+    dirtyTriangles.clear();
+}
+// E key: lifts a patch of the mesh and rotates the corners of its triangles, which keeps them the same
+// triangles but changes how they are packed, so both the vertex and the triangle path get exercised
+void Engine::editDemo() {
+    // chunks only describe a pool of one mesh, see appendMesh
+    if (meshRanges.size() > 1) {
+        std::cout << "Mesh edits need a single mesh, the pool holds " << meshRanges.size() << std::endl;
+        return;
+    }
+    // the levels' meshlets sit behind the mesh's own and weren't built from the edited triangles
+    if (!meshLods.empty()) {
+        std::cout << "Mesh edits can't be combined with levels of detail" << std::endl;
+        return;
+    }
+    uint32_t triangleCount = mesh.indices.size()/3;
+    uint32_t count = std::max(1u, triangleCount/100);
+    uint32_t first = uint64_t(editCount++) * 7919 * count % std::max(1u, triangleCount - count + 1);
+
+    std::vector<uint32_t> indices(mesh.indices.begin() + size_t(first)*3, mesh.indices.begin() + size_t(first + count)*3);
+    uint32_t firstVertex = *std::min_element(indices.begin(), indices.end());
+    uint32_t lastVertex = *std::max_element(indices.begin(), indices.end()) + 1;
+    std::vector<Vertex> vertices(mesh.vertices.begin() + firstVertex, mesh.vertices.begin() + lastVertex);
+    std::vector<bool> lifted(vertices.size(), false);
+    for (uint32_t index: indices) {
+        if (lifted[index - firstVertex]) continue;
+        lifted[index - firstVertex] = true;
+        Vertex& vertex = vertices[index - firstVertex];
+        vertex.z = floatToHalf(halfToFloat(vertex.z) + 0.02f);
+    }
+    for (size_t i=0; i<indices.size(); i+=3) {
+        std::rotate(indices.begin() + i, indices.begin() + i + 1, indices.begin() + i + 3);
+    }
+    editVertices(firstVertex, vertices);
+    editTriangles(first, indices);
+}
+void Engine::createCullBuffers() {
+    if (cullPipeline == VK_NULL_HANDLE) return;
+    // every meshlet of every instance of its mesh gets a thread and a slot in both lists, one dispatch dimension is the limit
+    uint64_t drawCapacity = 0;
+    for (const auto& range: meshRanges) drawCapacity += uint64_t(range.meshletCount)*range.instanceCount;
+    if (drawCapacity > 65535ull*64) {
+        std::cout << "Culling disabled, " << drawCapacity << " meshlet instances are more than one dispatch can cull" << std::endl;
+        return;
+    }
+    cullDrawCapacity = drawCapacity;
+    // one indexed draw per meshlet, where its triangles are in the index buffer depends on the index order
+    std::vector<VkDrawIndexedIndirectCommand> draws(mesh.meshlets.size());
+    uint32_t firstIndex = 0;
+    size_t group = 0;
+    for (size_t i=0; i<mesh.meshlets.size(); i++) {
+        while (group + 1 < indexGroups.size() && firstIndex >= indexGroups[group].firstIndex + indexGroups[group].indexCount) group++;
+        draws[i].indexCount = mesh.meshlets[i].triangleCount*3;
+        draws[i].instanceCount = 1;
+        draws[i].firstIndex = firstIndex;
+        draws[i].vertexOffset = indexGroups[group].vertexOffset;
+        draws[i].firstInstance = 0;
+        firstIndex += draws[i].indexCount;
+    }
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    cullBoundsRange.offset = 0;
+    cullBoundsRange.size = sizeof(MeshletBounds)*mesh.meshletBounds.size();
+    cullDrawRange.offset = alignUp(cullBoundsRange.size, props.limits.minStorageBufferOffsetAlignment);
+    cullDrawRange.size = sizeof(VkDrawIndexedIndirectCommand)*draws.size();
+    cullVisibilityRange.offset = alignUp(cullDrawRange.offset + cullDrawRange.size, props.limits.minStorageBufferOffsetAlignment);
+    cullVisibilityRange.size = sizeof(uint32_t)*cullDrawCapacity;
+    VkDeviceSize size = cullVisibilityRange.offset + cullVisibilityRange.size;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* data;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy((char*)data + cullBoundsRange.offset, mesh.meshletBounds.data(), cullBoundsRange.size);
+    memcpy((char*)data + cullDrawRange.offset, draws.data(), cullDrawRange.size);
+    memset((char*)data + cullVisibilityRange.offset, 0, cullVisibilityRange.size); // nothing was visible before the first frame
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    createBuffer(cullBuffer, cullBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    copyBuffer(stagingBuffer, cullBuffer, size);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+
+    // an early and a late list, each with its own count
+    createBuffer(visibleDrawBuffer, visibleDrawBufferMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        sizeof(VkDrawIndexedIndirectCommand)*cullDrawCapacity*2, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(drawCountBuffer, drawCountBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(uint32_t)*2, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+void Engine::destroyCullBuffers() {
+    vkDestroyBuffer(device, cullBuffer, nullptr);
+    vkFreeMemory(device, cullBufferMemory, nullptr);
+    vkDestroyBuffer(device, visibleDrawBuffer, nullptr);
+    vkFreeMemory(device, visibleDrawBufferMemory, nullptr);
+    vkDestroyBuffer(device, drawCountBuffer, nullptr);
+    vkFreeMemory(device, drawCountBufferMemory, nullptr);
+    cullBuffer = visibleDrawBuffer = drawCountBuffer = VK_NULL_HANDLE;
+    cullBufferMemory = visibleDrawBufferMemory = drawCountBufferMemory = VK_NULL_HANDLE;
+}
+void Engine::createDrawBuffers() {
+    if (options.gpuMeshlets) meshRanges[0].meshletCount = gpuMeshletCount;
+    // the culled draws already carry the instance index, they read it through the identity order
+    std::vector<uint32_t> identity(instances.size());
+    for (uint32_t i=0; i<identity.size(); i++) identity[i] = i;
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    meshTableRange.offset = 0;
+    meshTableRange.size = sizeof(MeshRange)*meshRanges.size();
+    instanceOrderRange.offset = alignUp(meshTableRange.size, props.limits.minStorageBufferOffsetAlignment);
+    instanceOrderRange.size = sizeof(uint32_t)*identity.size();
+    VkDeviceSize size = instanceOrderRange.offset + instanceOrderRange.size;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* data;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy((char*)data + meshTableRange.offset, meshRanges.data(), meshTableRange.size);
+    memcpy((char*)data + instanceOrderRange.offset, identity.data(), instanceOrderRange.size);
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    createBuffer(drawBuffer, drawBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    copyBuffer(stagingBuffer, drawBuffer, size);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+}
+void Engine::destroyDrawBuffers() {
+    vkDestroyBuffer(device, drawBuffer, nullptr);
+    vkFreeMemory(device, drawBufferMemory, nullptr);
+    drawBuffer = VK_NULL_HANDLE;
+    drawBufferMemory = VK_NULL_HANDLE;
+}
+// one packet per instance, sorted and collapsed into runs, a run becomes an instanced draw per index group on the
+// vertex path and per batch of instances on the mesh path, runs of the same state share an indirect call
+void Engine::buildDrawList(uint32_t currFrame) {
+    auto start = std::chrono::high_resolution_clock::now();
+    // there is one texture for the whole scene and one pipeline per frame, so every packet shares its state and
+    // the key only orders meshes, the depth bucket sorts front to back inside a mesh, which is what the early depth test wants
+    uint32_t pipeline = MESH_SHADERS_ENABLED ? 1 : 0;
+    glm::mat4 modelView = frameUbo.view * frameUbo.model;
+    float zfar = frameUbo.proj[3][2] / (frameUbo.proj[2][2] + 1.0f);
+    float maxBucket = float((1u << DRAW_KEY_DEPTH_BITS) - 1);
+    drawPackets.resize(instances.size());
+    for (uint32_t m=0; m<meshRanges.size(); m++) {
+        for (uint32_t i=meshRanges[m].firstInstance; i<meshRanges[m].firstInstance + meshRanges[m].instanceCount; i++) {
+            float depth = -(modelView * glm::vec4(instances[i].position, 1.0f)).z;
+            uint32_t bucket = uint32_t(std::clamp(depth / zfar, 0.0f, 1.0f) * maxBucket);
+            drawPackets[i] = {makeDrawKey(pipeline, 0, m, bucket), i};
+        }
+    }
+    drawListStats.packets = drawPackets.size();
+    sortDrawPackets(drawPackets, drawPacketScratch);
+    collectDrawRuns(drawPackets, drawRuns);
+    drawListStats.runs = drawRuns.size();
+
+    // commands of a run go out in order, a new call starts where the state changes
+    size_t commandSize = MESH_SHADERS_ENABLED ? sizeof(MeshTaskDraw) : sizeof(VkDrawIndexedIndirectCommand);
+    size_t commandCount = 0;
+    drawListStats.directDraws = 0;
+    for (const auto& run: drawRuns) {
+        const MeshRange& range = meshRanges[run.mesh];
+        if (!MESH_SHADERS_ENABLED) {
+            commandCount += meshGroupOffsets[run.mesh+1] - meshGroupOffsets[run.mesh];
+            drawListStats.directDraws += size_t(run.packetCount)*(meshGroupOffsets[run.mesh+1] - meshGroupOffsets[run.mesh]);
+        } else if (range.meshletCount > 0) {
+            uint32_t batch = std::max(1u, std::min(maxMeshWorkGroupCount[1], maxMeshWorkGroupTotalCount / range.meshletCount));
+            commandCount += (run.packetCount + batch - 1) / batch;
+            drawListStats.directDraws += run.packetCount;
+        }
+    }
+    drawListOrderRange.offset = 0;
+    drawListOrderRange.size = sizeof(uint32_t)*drawPackets.size();
+    drawListCommandRange.offset = alignUp(drawListOrderRange.size, storageBufferAlignment);
+    // the GPU meshlet build's indirect draw reads the first command, it has to exist even if nothing is drawn
+    drawListCommandRange.size = commandSize*std::max<size_t>(commandCount, 1);
+    VkDeviceSize size = drawListCommandRange.offset + drawListCommandRange.size;
+
+    if (drawListBuffers.empty()) {
+        drawListBuffers.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+        drawListBufferMemory.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+        drawListBufferMapped.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+        drawListBufferSizes.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    }
+    // the frame's fence was waited on, nothing reads this frame's buffer anymore
+    if (drawListBufferSizes[currFrame] < size) {
+        vkDestroyBuffer(device, drawListBuffers[currFrame], nullptr);
+        vkFreeMemory(device, drawListBufferMemory[currFrame], nullptr);
+        VkDeviceSize capacity = std::max(size, drawListBufferSizes[currFrame]*2);
+        createBuffer(drawListBuffers[currFrame], drawListBufferMemory[currFrame],
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, capacity,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkMapMemory(device, drawListBufferMemory[currFrame], 0, capacity, 0, &drawListBufferMapped[currFrame]);
+        drawListBufferSizes[currFrame] = capacity;
+    }
+    char* data = (char*)drawListBufferMapped[currFrame];
+    uint32_t* order = (uint32_t*)(data + drawListOrderRange.offset);
+    for (size_t i=0; i<drawPackets.size(); i++) order[i] = drawPackets[i].instance;
+
+    // instances are addressed by their slot in the sorted order, which is what firstInstance counts
+    VkDrawIndexedIndirectCommand* sceneDraws = (VkDrawIndexedIndirectCommand*)(data + drawListCommandRange.offset);
+    MeshTaskDraw* taskDraws = (MeshTaskDraw*)(data + drawListCommandRange.offset);
+    if (MESH_SHADERS_ENABLED) taskDraws[0] = {{0, 1, 1}, 0, 0};
+    uint32_t command = 0;
+    drawCalls.clear();
+    for (const auto& run: drawRuns) {
+        if (drawCalls.empty() || drawCalls.back().state != run.state) drawCalls.push_back({run.state, command, 0});
+        const MeshRange& range = meshRanges[run.mesh];
+        if (!MESH_SHADERS_ENABLED) {
+            for (uint32_t g=meshGroupOffsets[run.mesh]; g<meshGroupOffsets[run.mesh+1]; g++) {
+                sceneDraws[command++] = {indexGroups[g].indexCount, run.packetCount, indexGroups[g].firstIndex,
+                    int32_t(indexGroups[g].vertexOffset), run.firstPacket};
+            }
+        } else if (range.meshletCount > 0) {
+            uint32_t batch = std::max(1u, std::min(maxMeshWorkGroupCount[1], maxMeshWorkGroupTotalCount / range.meshletCount));
+            for (uint32_t first=0; first<run.packetCount; first+=batch) {
+                MeshTaskDraw draw{};
+                draw.command = {range.meshletCount, std::min(batch, run.packetCount - first), 1};
+                draw.meshletOffset = range.meshletOffset;
+                draw.firstInstance = run.firstPacket + first;
+                taskDraws[command++] = draw;
+            }
+        }
+        drawCalls.back().commandCount = command - drawCalls.back().firstCommand;
+    }
+    drawListStats.commands = command;
+    drawListStats.calls = drawCalls.size();
+    auto end = std::chrono::high_resolution_clock::now();
+    drawListStats.sortMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    const DrawListStats& last = reportedDrawListStats;
+    if (last.packets != drawListStats.packets || last.runs != drawListStats.runs || last.commands != drawListStats.commands ||
+        last.calls != drawListStats.calls) {
+        std::cout << "Draw list: " << drawListStats.packets << " packets in " << drawListStats.runs << " runs, "
+            << drawListStats.commands << " indirect commands in " << drawListStats.calls << " calls, "
+            << drawListStats.directDraws - drawListStats.calls << " of " << drawListStats.directDraws
+            << " draws eliminated, built in " << std::fixed << std::setprecision(3) << drawListStats.sortMs << "ms"
+            << std::defaultfloat << std::endl;
+        reportedDrawListStats = drawListStats;
+    }
+}
+void Engine::destroyDrawListBuffers() {
+    for (size_t i=0; i<drawListBuffers.size(); i++) {
+        vkDestroyBuffer(device, drawListBuffers[i], nullptr);
+        vkFreeMemory(device, drawListBufferMemory[i], nullptr);
+    }
+    drawListBuffers.clear();
+    drawListBufferMemory.clear();
+    drawListBufferMapped.clear();
+    drawListBufferSizes.clear();
+}
+void Engine::recordCull(VkCommandBuffer cmdBuffer, uint32_t currFrame, uint32_t phase) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    if (phase != CULL_LATE) {
+        // the previous frame's indirect draws may still read the counts and the lists, so the clear waits for them
+        vkCmdPipelineBarrier(cmdBuffer,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            0, nullptr);
+        vkCmdFillBuffer(cmdBuffer, drawCountBuffer, 0, sizeof(uint32_t)*2, 0);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+    }
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    std::array<VkDescriptorBufferInfo, 9> bufferInfo{};
+    bufferInfo[0] = {cullBuffer, cullBoundsRange.offset, cullBoundsRange.size};
+    bufferInfo[1] = {cullBuffer, cullDrawRange.offset, cullDrawRange.size};
+    bufferInfo[2] = {visibleDrawBuffer, 0, sizeof(VkDrawIndexedIndirectCommand)*cullDrawCapacity*2};
+    bufferInfo[3] = {drawCountBuffer, 0, sizeof(uint32_t)*2};
+    bufferInfo[4] = {cullBuffer, cullVisibilityRange.offset, cullVisibilityRange.size};
+    bufferInfo[6] = {instanceBuffer, 0, sizeof(Instance)*instances.size()};
+    bufferInfo[7] = {drawBuffer, meshTableRange.offset, meshTableRange.size};
+    bufferInfo[8] = {counterBuffer, counterStride*currFrame, sizeof(PipelineCounters)};
+    VkDescriptorImageInfo imageInfo{depthPyramidSampler, depthPyramidView, VK_IMAGE_LAYOUT_GENERAL};
+    std::array<VkWriteDescriptorSet, 9> writeDescriptorSet{};
+    for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].dstBinding = i;
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet[i].pBufferInfo = &bufferInfo[i];
+    }
+    writeDescriptorSet[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescriptorSet[5].pBufferInfo = nullptr;
+    writeDescriptorSet[5].pImageInfo = &imageInfo;
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0,
+        writeDescriptorSet.size(), writeDescriptorSet.data());
+
+    // the side planes of a symmetric frustum go through the camera, so two normals describe all four,
+    // near and far come back out of the projection
+    const glm::mat4& proj = frameUbo.proj;
+    CullConstants constants{};
+    constants.modelView = frameUbo.view * frameUbo.model;
+    float lengthX = std::sqrt(proj[0][0]*proj[0][0] + 1.0f);
+    float lengthY = std::sqrt(proj[1][1]*proj[1][1] + 1.0f);
+    constants.frustum = glm::vec4(proj[0][0] / lengthX, 1.0f / lengthX, std::abs(proj[1][1]) / lengthY, 1.0f / lengthY);
+    constants.projection = glm::vec4(proj[0][0], proj[1][1], proj[2][2], proj[3][2]);
+    constants.znear = proj[3][2] / proj[2][2];
+    constants.zfar = proj[3][2] / (proj[2][2] + 1.0f);
+    constants.drawCapacity = cullDrawCapacity;
+    constants.phase = phase;
+    constants.pyramidSize = glm::vec2(depthPyramidWidth, depthPyramidHeight);
+    constants.viewportScale = glm::vec2(renderExtent.width, renderExtent.height) / glm::vec2(swapchainExtent.width, swapchainExtent.height);
+    constants.meshCount = meshRanges.size();
+    vkCmdPushConstants(cmdBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmdBuffer, (cullDrawCapacity + 63)/64, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+void Engine::createLightBuffers() {
+    // the descriptors of set 0 have to be valid even without lights, so there is always one light and one grid,
+    // the lights are placed over the instances, which is why this runs after createInstanceBuffer
+    generateLights(lights, options.lights, instances.size());
+    std::vector<Light> data = lights;
+    if (data.empty()) data.push_back(Light{});
+    VkDeviceSize size = sizeof(Light)*data.size();
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* mapped;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data.data(), size);
+    vkUnmapMemory(device, stagingBufferMemory);
+    createBuffer(lightBuffer, lightBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    copyBuffer(stagingBuffer, lightBuffer, size);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+
+    // the counts, then LIGHT_CLUSTER_CAPACITY indices per cluster, only the binning writes it
+    VkDeviceSize gridSize = sizeof(uint32_t)*LIGHT_CLUSTER_COUNT*(lights.empty() ? 1 : 1 + LIGHT_CLUSTER_CAPACITY);
+    lightGridBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    lightGridBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    std::vector<std::array<VkDescriptorBufferInfo, 2>> bufferInfos(MAX_FRAMES_IN_FLIGHT);
+    for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(lightGridBuffers[i], lightGridBufferMemory[i], VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, gridSize,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+        auto& bufferInfo = bufferInfos[i];
+        bufferInfo = {{
+            {lightBuffer, 0, size},
+            {lightGridBuffers[i], 0, gridSize},
+        }};
+        for (uint32_t b=0; b<bufferInfo.size(); b++) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = descriptorSets[i];
+            write.dstBinding = 2 + b;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfo[b];
+            descriptorWrites.push_back(write);
+        }
+    }
+    vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    if (lightCullPipeline != VK_NULL_HANDLE) {
+        std::cout << "Lights: " << lights.size() << " in " << LIGHT_CLUSTERS_X << "x" << LIGHT_CLUSTERS_Y << "x"
+            << LIGHT_CLUSTERS_Z << " clusters of up to " << LIGHT_CLUSTER_CAPACITY << std::endl;
+    }
+}
+void Engine::destroyLightBuffers() {
+    vkDestroyBuffer(device, lightBuffer, nullptr);
+    vkFreeMemory(device, lightBufferMemory, nullptr);
+    for (size_t i=0; i<lightGridBuffers.size(); i++) {
+        vkDestroyBuffer(device, lightGridBuffers[i], nullptr);
+        vkFreeMemory(device, lightGridBufferMemory[i], nullptr);
+    }
+    lightGridBuffers.clear();
+    lightGridBufferMemory.clear();
+    lightBuffer = VK_NULL_HANDLE;
+    lightBufferMemory = VK_NULL_HANDLE;
+}
+void Engine::createCounterBuffers() {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    counterStride = alignUp(sizeof(PipelineCounters), props.limits.minStorageBufferOffsetAlignment);
+    VkDeviceSize size = counterStride*MAX_FRAMES_IN_FLIGHT;
+    createBuffer(counterBuffer, counterBufferMemory,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(counterReadbackBuffer, counterReadbackBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkMapMemory(device, counterReadbackBufferMemory, 0, size, 0, &counterReadbackMapped);
+    countersWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+void Engine::destroyCounterBuffers() {
+    vkDestroyBuffer(device, counterBuffer, nullptr);
+    vkFreeMemory(device, counterBufferMemory, nullptr);
+    vkDestroyBuffer(device, counterReadbackBuffer, nullptr);
+    vkFreeMemory(device, counterReadbackBufferMemory, nullptr);
+    counterBuffer = counterReadbackBuffer = VK_NULL_HANDLE;
+    counterBufferMemory = counterReadbackBufferMemory = VK_NULL_HANDLE;
+    counterReadbackMapped = nullptr;
+}
+// the frame's slot is only touched by this frame, the last frame that used it is behind the slot's fence
+void Engine::recordCounterReset(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    vkCmdFillBuffer(cmdBuffer, counterBuffer, counterStride*currFrame, sizeof(PipelineCounters), 0);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (MESH_SHADERS_SUPPORTED) stages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, stages,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+// copies the frame's counters out after the last pass that adds to them, run reads them once the fence signals
+void Engine::recordCounterReadback(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (MESH_SHADERS_SUPPORTED) stages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        stages, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+    VkBufferCopy region{counterStride*currFrame, counterStride*currFrame, sizeof(PipelineCounters)};
+    vkCmdCopyBuffer(cmdBuffer, counterBuffer, counterReadbackBuffer, 1, &region);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+    countersWritten[currFrame] = true;
+}
+// bins the lights into the clusters of this frame's view, before anything is shaded, on the async compute queue
+// the semaphore the graphics submit waits for takes the place of the barriers
+void Engine::recordLightCull(VkCommandBuffer cmdBuffer, uint32_t currFrame, bool async) {
+    if (!async) {
+        // the frame that last used this grid may still read the lists
+        vkCmdPipelineBarrier(cmdBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            0, nullptr);
+    }
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipelineLayout, 0, 1,
+        &descriptorSets[currFrame], 0, nullptr);
+    vkCmdDispatch(cmdBuffer, (LIGHT_CLUSTER_COUNT + 63)/64, 1, 1);
+    if (async) return;
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+void Engine::createLodBuffers() {
+    if (lodPipeline == VK_NULL_HANDLE) return;
+    if ((instances.size() + 63)/64 > maxComputeWorkGroupCountX) {
+        std::cout << "Levels of detail disabled, " << instances.size() << " instances are more than one dispatch takes" << std::endl;
+        return;
+    }
+    // every level gets as many batches as it needs if all of the mesh's instances pick it, and a slice of the
+    // instance order as long as that, so the selection never runs out of room
+    std::vector<MeshTaskDraw> commands;
+    uint32_t instanceBase = 0;
+    for (uint32_t m=0; m<meshRanges.size(); m++) {
+        for (uint32_t l=0; l<LOD_MAX_LEVELS; l++) {
+            MeshLod& lod = meshLods[m * LOD_MAX_LEVELS + l];
+            if (lod.meshletCount == 0) continue;
+            lod.batchSize = std::max(1u, std::min(maxMeshWorkGroupCount[1], maxMeshWorkGroupTotalCount / lod.meshletCount));
+            lod.firstCommand = commands.size();
+            lod.instanceBase = instanceBase;
+            for (uint32_t first=0; first<meshRanges[m].instanceCount; first+=lod.batchSize) {
+                commands.push_back({{lod.meshletCount, 0, 1}, lod.meshletOffset, instanceBase + first});
+            }
+            instanceBase += meshRanges[m].instanceCount;
+        }
+    }
+    lodCommandCount = commands.size();
+
+    // the reset range is copied over the commands and counts at the start of every frame
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    VkDeviceSize alignment = props.limits.minStorageBufferOffsetAlignment;
+    VkDeviceSize countOffset = alignUp(sizeof(MeshTaskDraw)*commands.size(), alignment);
+    lodTableRange.offset = 0;
+    lodTableRange.size = sizeof(MeshLod)*meshLods.size();
+    lodResetRange.offset = alignUp(lodTableRange.size, alignment);
+    lodResetRange.size = countOffset + sizeof(uint32_t)*meshLods.size();
+    lodCommandRange.offset = alignUp(lodResetRange.offset + lodResetRange.size, alignment);
+    lodCommandRange.size = sizeof(MeshTaskDraw)*commands.size();
+    lodCountRange.offset = lodCommandRange.offset + countOffset;
+    lodCountRange.size = sizeof(uint32_t)*meshLods.size();
+    lodOrderRange.offset = alignUp(lodCountRange.offset + lodCountRange.size, alignment);
+    lodOrderRange.size = sizeof(uint32_t)*std::max(instanceBase, 1u);
+    VkDeviceSize size = lodOrderRange.offset + lodOrderRange.size;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* data;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+    memset(data, 0, size);
+    memcpy((char*)data + lodTableRange.offset, meshLods.data(), lodTableRange.size);
+    memcpy((char*)data + lodResetRange.offset, commands.data(), sizeof(MeshTaskDraw)*commands.size());
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    createBuffer(lodBuffer, lodBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    copyBuffer(stagingBuffer, lodBuffer, size);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    std::cout << "Levels of detail: " << lodThreshold << " pixels, " << lodCommandCount << " indirect commands, toggle with L" << std::endl;
+}
+void Engine::destroyLodBuffers() {
+    vkDestroyBuffer(device, lodBuffer, nullptr);
+    vkFreeMemory(device, lodBufferMemory, nullptr);
+    lodBuffer = VK_NULL_HANDLE;
+    lodBufferMemory = VK_NULL_HANDLE;
+}
+// resets the level draws and lets lod.comp fill them, replaces the draw list on the mesh path
+void Engine::recordLodSelect(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    // the previous frame's draws may still be read
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        0, nullptr);
+    VkBufferCopy copy{lodResetRange.offset, lodCommandRange.offset, lodResetRange.size};
+    vkCmdCopyBuffer(cmdBuffer, lodBuffer, lodBuffer, 1, &copy);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+    std::array<VkDescriptorBufferInfo, 6> bufferInfo = {{
+        {instanceBuffer, 0, sizeof(Instance)*instances.size()},
+        {drawBuffer, meshTableRange.offset, meshTableRange.size},
+        {lodBuffer, lodTableRange.offset, lodTableRange.size},
+        {lodBuffer, lodCommandRange.offset, lodCommandRange.size},
+        {lodBuffer, lodCountRange.offset, lodCountRange.size},
+        {lodBuffer, lodOrderRange.offset, lodOrderRange.size},
+    }};
+    std::array<VkWriteDescriptorSet, 6> writeDescriptorSet{};
+    for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].dstBinding = i;
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet[i].pBufferInfo = &bufferInfo[i];
+    }
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lodPipeline);
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lodPipelineLayout, 1,
+        writeDescriptorSet.size(), writeDescriptorSet.data());
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lodPipelineLayout, 0, 1,
+        &descriptorSets[currFrame], 0, nullptr);
+    LodConstants constants{};
+    constants.threshold = lodThreshold;
+    constants.viewportHeight = renderExtent.height; // the pixels the levels are judged in are the rendered ones
+    constants.instanceCount = instances.size();
+    constants.meshCount = meshRanges.size();
+    vkCmdPushConstants(cmdBuffer, lodPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmdBuffer, (instances.size() + 63)/64, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+void Engine::createRasterBuffers() {
+    if (rasterClassifyPipeline == VK_NULL_HANDLE || cullBuffer == VK_NULL_HANDLE) return;
+    // every cluster of the mesh path is a mesh workgroup of one indirect draw, the cluster index also has to leave
+    // 7 bits for the triangle in the visibility id, which the cull pass' limit already keeps it below
+    if (cullDrawCapacity > maxMeshWorkGroupCount[0] || cullDrawCapacity > maxMeshWorkGroupTotalCount) {
+        std::cout << "Hybrid rasterization disabled, " << cullDrawCapacity << " meshlet instances are more than one mesh draw takes" << std::endl;
+        return;
+    }
+    // the compute rasterizer takes a workgroup per cluster, the rest of the small ones stay on the mesh path
+    swRasterCapacity = std::min(cullDrawCapacity, maxComputeWorkGroupCountX);
+    createBuffer(clusterBuffer, clusterBufferMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        sizeof(glm::uvec2)*(cullDrawCapacity + swRasterCapacity), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(rasterCommandBuffer, rasterCommandBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(uint32_t)*6, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (swRasterThreshold > 0.0f) {
+        std::cout << "Hybrid rasterization: " << swRasterThreshold << " pixels per triangle, in visibility buffer mode (V)" << std::endl;
+    }
+}
+void Engine::destroyRasterBuffers() {
+    vkDestroyBuffer(device, clusterBuffer, nullptr);
+    vkFreeMemory(device, clusterBufferMemory, nullptr);
+    vkDestroyBuffer(device, rasterCommandBuffer, nullptr);
+    vkFreeMemory(device, rasterCommandBufferMemory, nullptr);
+    clusterBuffer = rasterCommandBuffer = VK_NULL_HANDLE;
+    clusterBufferMemory = rasterCommandBufferMemory = VK_NULL_HANDLE;
+}
+// all three passes of the hybrid rasterizer share the descriptors and the constants
+void Engine::pushRasterDescriptors(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    std::array<VkDescriptorBufferInfo, 10> bufferInfo = {{
+        {cullBuffer, cullBoundsRange.offset, cullBoundsRange.size},
+        {instanceBuffer, 0, sizeof(Instance)*instances.size()},
+        {drawBuffer, meshTableRange.offset, meshTableRange.size},
+        {meshletBuffer, meshletHeaderRange.offset, meshletHeaderRange.size},
+        {meshletBuffer, meshletVertexRange.offset, meshletVertexRange.size},
+        {meshletBuffer, meshletTriangleRange.offset, meshletTriangleRange.size},
+        {positionBuffer, 0, positionBufferSize},
+        {clusterBuffer, 0, VK_WHOLE_SIZE},
+        {rasterCommandBuffer, 0, VK_WHOLE_SIZE},
+        {swVisibilityBuffer, 0, VK_WHOLE_SIZE},
+    }};
+    VkDescriptorImageInfo visibilityInfo{VK_NULL_HANDLE, visibilityImageView, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo depthInfo{depthPyramidSampler, visibilityDepthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+    std::array<VkWriteDescriptorSet, 12> writeDescriptorSet{};
+    for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].dstBinding = i;
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet[i].pBufferInfo = i < bufferInfo.size() ? &bufferInfo[i] : nullptr;
+    }
+    writeDescriptorSet[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSet[10].pImageInfo = &visibilityInfo;
+    writeDescriptorSet[11].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescriptorSet[11].pImageInfo = &depthInfo;
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rasterPipelineLayout, 1,
+        writeDescriptorSet.size(), writeDescriptorSet.data());
+
+    RasterConstants constants{};
+    constants.viewport = glm::vec2(renderExtent.width, renderExtent.height);
+    constants.threshold = swRasterThreshold;
+    constants.clusterCapacity = cullDrawCapacity;
+    constants.softwareCapacity = swRasterCapacity;
+    constants.meshCount = meshRanges.size();
+    vkCmdPushConstants(cmdBuffer, rasterPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rasterPipelineLayout, 0, 1,
+        &descriptorSets[currFrame], 0, nullptr);
+}
+// splits the meshlets of every instance between the mesh path and the compute rasterizer, before the visibility pass
+void Engine::recordRasterClassify(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    // the previous frame's indirect draw and dispatch may still read the counts and the compute rasterizer its
+    // target, so the clears wait for them
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        0, nullptr);
+    // x of both commands counts up from 0, y and z stay 1
+    uint32_t commands[6] = {0, 1, 1, 0, 1, 1};
+    vkCmdUpdateBuffer(cmdBuffer, rasterCommandBuffer, 0, sizeof(commands), commands);
+    vkCmdFillBuffer(cmdBuffer, swVisibilityBuffer, 0, VK_WHOLE_SIZE, ~0u);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rasterClassifyPipeline);
+    pushRasterDescriptors(cmdBuffer, currFrame);
+    vkCmdDispatch(cmdBuffer, (cullDrawCapacity + 63)/64, 1, 1);
+
+    // the counts are the indirect commands, the lists are read by the mesh shader and the compute rasterizer
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+// rasterizes the small meshlets after the visibility pass and merges them into its result, the visibility pass'
+// outgoing dependency makes the ids and the depth visible to compute
+void Engine::recordSoftwareRaster(VkCommandBuffer cmdBuffer, uint32_t currFrame) {
+    // a workgroup per cluster the classification counted
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, swRasterPipeline);
+    pushRasterDescriptors(cmdBuffer, currFrame);
+    vkCmdDispatchIndirect(cmdBuffer, rasterCommandBuffer, sizeof(uint32_t)*3);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+    // a thread per pixel, the push descriptors and constants carry over as the layout is the same
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, swResolvePipeline);
+    vkCmdDispatch(cmdBuffer, (renderExtent.width + 7)/8, (renderExtent.height + 7)/8, 1);
+
+    // the shading pass reads the merged ids
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+void Engine::createDepthPyramid() {
+    // level 0 is the depth buffer rounded down to powers of two, so every level is exactly half of the one above
+    auto previousPowerOfTwo = [](uint32_t value) {
+        uint32_t power = 1;
+        while (power*2 <= value) power *= 2;
+        return power;
+    };
+    depthPyramidWidth = previousPowerOfTwo(swapchainExtent.width);
+    depthPyramidHeight = previousPowerOfTwo(swapchainExtent.height);
+    depthPyramidLevels = std::floor(std::log2(std::max(depthPyramidWidth, depthPyramidHeight))) + 1;
+    createImage(depthPyramid, depthPyramidMemory, depthPyramidWidth, depthPyramidHeight, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthPyramidLevels, VK_SAMPLE_COUNT_1_BIT);
+    createImageView(depthPyramid, depthPyramidView, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, depthPyramidLevels);
+    // every level is written through its own view
+    depthPyramidMips.resize(depthPyramidLevels);
+    for (uint32_t i=0; i<depthPyramidLevels; i++) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = depthPyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = i;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthPyramidMips[i]));
+    }
+    // culling binds the pyramid as GENERAL even on frames nothing reduced into it, so it starts out there
+    transitionImageLayout(depthPyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, depthPyramidLevels);
+
+    if (depthPyramidSampler == VK_NULL_HANDLE) {
+        // only texelFetch reads the pyramid, but the descriptors are combined image samplers
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &depthPyramidSampler));
+    }
+}
+void Engine::destroyDepthPyramid() {
+    for (auto view: depthPyramidMips) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    depthPyramidMips.clear();
+    vkDestroyImageView(device, depthPyramidView, nullptr);
+    vkDestroyImage(device, depthPyramid, nullptr);
+    vkFreeMemory(device, depthPyramidMemory, nullptr);
+}
+void Engine::recordDepthPyramid(VkCommandBuffer cmdBuffer) {
+    // depth and stencil share the layout unless the device separates them
+    VkImageAspectFlags depthAspect = depthFormat == VK_FORMAT_D32_SFLOAT ?
+        VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    // the early pass' depth is read by compute, the pyramid is rewritten as a whole so its old contents don't matter
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = depthImage;
+    barriers[0].subresourceRange = {depthAspect, 0, 1, 0, 1};
+    barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = depthPyramid;
+    barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramidLevels, 0, 1};
+    // compute covers the previous frame's late cull still reading the pyramid
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        barriers.size(), barriers.data());
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipeline);
+    PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (uint32_t level=0; level<depthPyramidLevels; level++) {
+        std::array<VkDescriptorImageInfo, 3> imageInfo{};
+        imageInfo[0] = {depthPyramidSampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        imageInfo[1] = {depthPyramidSampler, depthPyramidView, VK_IMAGE_LAYOUT_GENERAL};
+        imageInfo[2] = {VK_NULL_HANDLE, depthPyramidMips[level], VK_IMAGE_LAYOUT_GENERAL};
+        std::array<VkWriteDescriptorSet, 3> writeDescriptorSet{};
+        for (uint32_t i=0; i<writeDescriptorSet.size(); i++) {
+            writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet[i].dstBinding = i;
+            writeDescriptorSet[i].descriptorCount = 1;
+            writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writeDescriptorSet[i].pImageInfo = &imageInfo[i];
+        }
+        writeDescriptorSet[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        vkCmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipelineLayout, 0,
+            writeDescriptorSet.size(), writeDescriptorSet.data());
+        uint32_t constants[3] = {std::max(1u, depthPyramidWidth >> level), std::max(1u, depthPyramidHeight >> level), level};
+        vkCmdPushConstants(cmdBuffer, depthReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), constants);
+        vkCmdDispatch(cmdBuffer, (constants[0] + 7)/8, (constants[1] + 7)/8, 1);
+        // the next level reads this one, after the last one the late cull does
+        vkCmdPipelineBarrier(cmdBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+    }
+
+    // depth goes back to being the attachment the late pass continues on
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barriers[0]);
+}
 void Engine::createUniformBuffers() {
     VkDeviceSize size = sizeof(UniformBufferObject);
     uniformBufferMapped.resize(MAX_FRAMES_IN_FLIGHT);
     uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
     uniformBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
     for (int i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        // shared as the light binning reads the matrices on the async compute queue
         createBuffer(uniformBuffers[i], uniformBufferMemory[i], VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, size, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
         // persistent mapping since values are updated every frame
         vkMapMemory(device, uniformBufferMemory[i], 0, size, 0, &uniformBufferMapped[i]);
     }
 }
 void Engine::createDescriptorPool() {
     // this describes only one descriptor type per pool
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT; // how many descriptors of this type to create
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2; // the lights and their clusters
 
     // descriptor sets must be allocated from a descriptor pool
     // so descriptor set here consists of two descriptors
@@ -849,10 +3073,19 @@ void Engine::updateUniformBuffers(uint32_t index) {
     ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     // ubo.model *= glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     // ubo.model *= glm::scale(glm::mat4(1.0f), glm::vec3(0.05f, 0.05f, 0.05f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float) swapchainExtent.height, 0.1f, 10.0f);
+    // the camera backs off so that an instance grid (3 units apart) fills the view like a single mesh does
+    float sceneScale = instances.size() > 1 ? std::ceil(std::sqrt(float(instances.size()))) * 1.5f : 1.0f;
+    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f) * sceneScale, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float) swapchainExtent.height, 0.1f * sceneScale, 10.0f * sceneScale);
     ubo.proj[1][1] *= -1;
+    frameClip = ubo.proj * ubo.view * ubo.model;
+    // a shift of proj[2] moves the whole frame by as much in ndc, the culling ignores the fraction of a pixel
+    ubo.proj[2][0] -= taaJitter.x * 2.0f / renderExtent.width;
+    ubo.proj[2][1] -= taaJitter.y * 2.0f / renderExtent.height;
+    ubo.viewport = glm::vec2(renderExtent.width, renderExtent.height);
+    ubo.lightCount = lightCullPipeline != VK_NULL_HANDLE ? lights.size() : 0;
     memcpy(uniformBufferMapped[index], &ubo, sizeof(UniformBufferObject));
+    frameUbo = ubo;
 }
 void Engine::createTextureImage() {
     int texWidth, texHeight, texChannels;
@@ -861,6 +3094,18 @@ void Engine::createTextureImage() {
     if (!pixels) throw std::runtime_error("Error: cannot read the texture file");
     mipLevels = std::floor(std::log2(std::max(texWidth, texHeight)))+1;
 
+    // mipmaps are blitted on the GPU when the format supports linear filtering, otherwise they are built here
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(pDevice, VK_FORMAT_R8G8B8A8_UNORM, &props);
+    bool blitSupported = props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    std::vector<uint8_t> mipChain;
+    if (!blitSupported) {
+        mipChain = generateMipChain(pixels, texWidth, texHeight, mipLevels);
+        stbi_image_free(pixels);
+        pixels = mipChain.data();
+        size = mipChain.size();
+    }
+
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     createBuffer(stagingBuffer, stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, 
@@ -869,15 +3114,22 @@ void Engine::createTextureImage() {
     vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
     memcpy(data, pixels, size);
     vkUnmapMemory(device, stagingBufferMemory);
-    stbi_image_free(pixels);
+    if (blitSupported) stbi_image_free(pixels);
 
     createImage(textureImage, textureImageMemory, texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels, VK_SAMPLE_COUNT_1_BIT);
     transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, 
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-    copyBufferToImage(stagingBuffer, textureImage, texWidth, texHeight);
-    generateMipmaps(textureImage, texWidth, texHeight, mipLevels, VK_FORMAT_R8G8B8A8_UNORM);
+    if (blitSupported) {
+        copyBufferToImage(stagingBuffer, textureImage, texWidth, texHeight);
+        generateMipmaps(textureImage, texWidth, texHeight, mipLevels, VK_FORMAT_R8G8B8A8_UNORM);
+    } else {
+        // the staging buffer already holds every level
+        copyBufferToImage(stagingBuffer, textureImage, texWidth, texHeight, mipLevels);
+        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    }
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
@@ -919,14 +3171,39 @@ void Engine::createDepthResources() {
             break;
         }
     }
+    // sampled as well when possible, the depth pyramid is built from it
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(pDevice, depthFormat, &props);
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
     createImage(depthImage, depthImageMemory, swapchainExtent.width, swapchainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, 
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, msaaSamples);
+        usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, msaaSamples);
     createImageView(depthImage, depthImageView, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 void Engine::createColorResources() {
-    createImage(colorImage, colorImageMemory, swapchainExtent.width, swapchainExtent.height, swapchainFormat, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, msaaSamples);
-    createImageView(colorImage, colorImageView, swapchainFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    // a single sample is drawn straight into the swapchain or the scene image
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        createImage(colorImage, colorImageMemory, swapchainExtent.width, swapchainExtent.height, swapchainFormat,
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, msaaSamples);
+        createImageView(colorImage, colorImageView, swapchainFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    }
+    if (sceneUpscaled) {
+        createImage(sceneImage, sceneImageMemory, swapchainExtent.width, swapchainExtent.height, swapchainFormat, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT);
+        createImageView(sceneImage, sceneImageView, swapchainFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    }
+    if (sceneUpscaled && options.taa) {
+        // in linear color with the precision to accumulate small weights
+        for (uint32_t i=0; i<historyImages.size(); i++) {
+            createImage(historyImages[i], historyImageMemory[i], swapchainExtent.width, swapchainExtent.height,
+                VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT);
+            createImageView(historyImages[i], historyImageViews[i], VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        }
+    }
+    historyValid = false;
 }
 void Engine::recreateSwapchain() {
     vkDeviceWaitIdle(device);
@@ -936,6 +3213,8 @@ void Engine::recreateSwapchain() {
     createSwapchain();
     createColorResources();
     createDepthResources();
+    createDepthPyramid();
+    createVisibilityResources();
     createFramebuffers();
 }
 
@@ -1063,13 +3342,24 @@ uint32_t Engine::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
     }
     throw std::runtime_error("Error: no suitable memory type");
 }
+// a shared buffer is used by the async compute queue as well, concurrent sharing saves the ownership transfers
 void Engine::createBuffer(VkBuffer& buffer, VkDeviceMemory& memory, VkBufferUsageFlags usage, 
-        VkDeviceSize size, VkMemoryPropertyFlags properties) {
+        VkDeviceSize size, VkMemoryPropertyFlags properties, bool shared) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    std::set<uint32_t> families;
+    if (shared && computeQueue != VK_NULL_HANDLE) {
+        families = {queueFamilies.graphicsFamily.value(), queueFamilies.transferFamily.value(), queueFamilies.computeFamily.value()};
+    }
+    std::vector<uint32_t> familyIndices(families.begin(), families.end());
+    if (familyIndices.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = familyIndices.size();
+        bufferInfo.pQueueFamilyIndices = familyIndices.data();
+    }
     VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
 
     VkMemoryRequirements memReq; // buffer's memory requirements, i.e size, alignment, memory type
@@ -1190,6 +3480,11 @@ void Engine::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
             barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
             srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
             dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
         }
 
         vkCmdPipelineBarrier(cmdBuffer, 
@@ -1214,7 +3509,7 @@ void Engine::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
     vkDestroyCommandPool(device, cmdPool, nullptr);
     vkDestroyFence(device, fence, nullptr);
 }
-void Engine::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
+void Engine::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels) {
     VkCommandPool cmdPool = createCommandPool(queueFamilies.transferFamily.value(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
     VkCommandBuffer cmdBuffer = createCommandBuffer(cmdPool);
 
@@ -1223,21 +3518,29 @@ void Engine::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, u
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmdBuffer, &beginInfo);
     {
-        VkBufferImageCopy copyRegion{};
-        // bufferImageHeight and bufferRowLength specify how pixels are laid out, i.e there may be padding
-        copyRegion.bufferImageHeight = 0;
-        copyRegion.bufferRowLength = 0;
-        copyRegion.bufferOffset = 0;
-
-        copyRegion.imageExtent = {width, height, 1};
-        copyRegion.imageOffset = {0, 0, 0};
-
-        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.imageSubresource.baseArrayLayer = 0;
-        copyRegion.imageSubresource.layerCount = 1;
-        copyRegion.imageSubresource.mipLevel = 0;
+        // one region per level, levels follow each other tightly packed like generateMipChain lays them out
+        std::vector<VkBufferImageCopy> copyRegions(mipLevels);
+        VkDeviceSize offset = 0;
+        for (uint32_t i=0; i<mipLevels; i++) {
+            VkBufferImageCopy& copyRegion = copyRegions[i];
+            // bufferImageHeight and bufferRowLength specify how pixels are laid out, i.e there may be padding
+            copyRegion.bufferImageHeight = 0;
+            copyRegion.bufferRowLength = 0;
+            copyRegion.bufferOffset = offset;
+
+            copyRegion.imageExtent = {width, height, 1};
+            copyRegion.imageOffset = {0, 0, 0};
+
+            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.imageSubresource.baseArrayLayer = 0;
+            copyRegion.imageSubresource.layerCount = 1;
+            copyRegion.imageSubresource.mipLevel = i;
+            offset += VkDeviceSize(width)*height*4;
+            if (width > 1) width /= 2;
+            if (height > 1) height /= 2;
+        }
         // VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL indicates what layout the image is currently using
-        vkCmdCopyBufferToImage(cmdBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+        vkCmdCopyBufferToImage(cmdBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyRegions.size(), copyRegions.data());
     }
     vkEndCommandBuffer(cmdBuffer);
 
@@ -1359,6 +3662,12 @@ VkSampleCountFlagBits Engine::getMaxSamples() {
     VkPhysicalDeviceProperties props{};
     vkGetPhysicalDeviceProperties(pDevice, &props);
     VkSampleCountFlags counts = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+    // --msaa caps it, the sample count bits are the counts themselves, the temporal upsampler antialiases over
+    // frames, so by default it takes a single sample
+    uint32_t cap = options.msaaSamples > 0 ? options.msaaSamples : options.taa ? 1 : 0;
+    if (cap > 0) {
+        for (uint32_t bit=VK_SAMPLE_COUNT_64_BIT; bit>cap; bit>>=1) counts &= ~bit;
+    }
     if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
     if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
     if (counts & VK_SAMPLE_COUNT_16_BIT) { return VK_SAMPLE_COUNT_16_BIT; }
@@ -1375,6 +3684,23 @@ void Engine::createQueryPool() {
     VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool));
     
     queryResults.resize(MAX_FRAMES_IN_FLIGHT * 2);
+
+    // start, after the mesh path and after the compute rasterizer, per frame in flight
+    poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 3;
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &rasterQueryPool));
+    rasterTimedPasses.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+    // around the light binning, per frame in flight
+    poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &lightQueryPool));
+    lightCullTimed.assign(MAX_FRAMES_IN_FLIGHT, false);
+    asyncComputeTimed.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+    // before the depth prepass, between it and shading and after shading, per frame in flight
+    poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 3;
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &prepassQueryPool));
+    prepassTimed.assign(MAX_FRAMES_IN_FLIGHT, false);
+    frameRenderScale.assign(MAX_FRAMES_IN_FLIGHT, 0.0f);
 }
 void Engine::isMeshShaderSupported() {
     uint32_t count = 0;
@@ -1383,8 +3709,30 @@ void Engine::isMeshShaderSupported() {
     vkEnumerateDeviceExtensionProperties(pDevice, nullptr, &count, availableExtensions.data());
     std::set<std::string> requestedExtensions(requiredDeviceExtensions.begin(), requiredDeviceExtensions.end());
     for (const auto ext: availableExtensions) {
-        if (strcmp(ext.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+        if (strcmp(ext.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0) {
             MESH_SHADERS_SUPPORTED = true;
         }
     }
+    // meshlet vertex deltas are decoded with a prefix sum across the subgroup in the mesh shader
+    VkPhysicalDeviceSubgroupProperties subgroupProps{};
+    subgroupProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 props{};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &subgroupProps;
+    vkGetPhysicalDeviceProperties2(pDevice, &props);
+    if (!(subgroupProps.supportedStages & VK_SHADER_STAGE_MESH_BIT_EXT) ||
+        !(subgroupProps.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT)) {
+        MESH_SHADERS_SUPPORTED = false;
+    }
+    // shader.mesh reads its indirect draw with gl_DrawIDARB, the module declares the capability on every path
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features11;
+    vkGetPhysicalDeviceFeatures2(pDevice, &features);
+    if (!features11.shaderDrawParameters) {
+        if (MESH_SHADERS_SUPPORTED) std::cout << "Mesh shaders: disabled, the device has no shader draw parameters" << std::endl;
+        MESH_SHADERS_SUPPORTED = false;
+    }
 }
\ No newline at end of file
@@ -1,14 +1,53 @@
 #pragma once
-#include "config.hpp"
+#include "Meshlets.hpp"
+#include "Synthetic.hpp"
+#include "Assets.hpp"
+#include "DrawList.hpp"
+#include "Lod.hpp"
+#include "Lights.hpp"
 
 #define USE_MESH 1
 
+// set from the command line in main.cpp
+struct EngineOptions {
+    bool meshletReport = false; // print meshlet quality metrics once the meshlets are built
+    bool meshletReportJson = false; // print them as JSON instead of text
+    std::string syntheticKind; // generate a mesh of this kind instead of loading MODEL_PATH, see generateSyntheticMesh
+    uint64_t syntheticTriangles = 0;
+    // more meshes for the geometry pool, an OBJ path or a synthetic kind with a triangle count each
+    struct MeshSource {
+        std::string path;
+        std::string syntheticKind;
+        uint64_t syntheticTriangles = 0;
+    };
+    std::vector<MeshSource> meshes;
+    bool gpuMeshlets = false; // build the meshlets from the index buffer with a compute shader instead of on the CPU
+    bool meshletIndices = false; // index buffer in meshlet order with 16 bit indices, so both paths read the same data order
+    uint32_t instances = 1; // copies of the meshes on a grid, see generateInstances, split evenly between the meshes
+    float swRasterThreshold = 0.0f; // pixels per triangle below which visibility buffer meshlets are rasterized in compute, 0 is off
+    bool lod = false; // build levels of detail, the mesh path picks one per instance on the GPU
+    float lodThreshold = 1.0f; // pixels a level may be off by on screen
+    uint32_t lights = 0; // point and spot lights over the scene, binned into clusters every frame, 0 leaves it unlit
+    bool depthPrepass = false; // lay down depth from the position stream first, then shade only where it is equal
+    uint32_t msaaSamples = 0; // most samples per pixel to use, 0 takes as many as the device has
+    bool asyncCompute = true; // bin the lights on a compute only queue when the device has one
+    float frameBudget = 0.0f; // GPU milliseconds per frame the render resolution is scaled to, 0 renders at full resolution
+    float renderScale = 1.0f; // per axis, the fixed render resolution without a frame budget
+    bool taa = false; // jitter the frames and accumulate them into a full resolution history instead of blitting them up
+};
+
 class Engine {
 public:
-    Engine();
+    Engine(const EngineOptions& options = {});
     ~Engine();
     void run();
     void onKey(int key, int scancode, int action, int mods);
+    // edits change mesh right away and are uploaded by flushMeshEdits, the vertex and triangle counts stay the same
+    void editVertices(uint32_t firstVertex, const std::vector<Vertex>& vertices);
+    void editTriangles(uint32_t firstTriangle, const std::vector<uint32_t>& indices);
+    void flushMeshEdits();
+    // what the cull pass and the mesh shader counted in the last frame read back, a few frames behind the one on screen
+    const PipelineCounters& getPipelineCounters() const { return pipelineCounters; }
 
 private:
     void loadModel();
@@ -21,11 +60,16 @@ private:
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
     void createRenderpass();
+    VkRenderPass createRenderpass(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp depthStoreOp);
     void createFramebuffers();
-    void recordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame);
+    void recordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame, bool asyncCompute);
+    void recordAsyncCompute(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void recordScene(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame, VkRenderPass pass, bool culled, uint32_t drawList,
+        DepthPrepass prepass);
     void recreateSwapchain();
     void cleanupSwapchain();
     void createVertexBuffer();
+    void createInstanceBuffer();
     void createIndexBuffer();
     void createMeshletBuffer();
     void createUniformBuffers();
@@ -36,6 +80,48 @@ private:
     void createTextureSampler();
     void createDepthResources();
     void createColorResources();
+    void createMeshletBuildPipeline();
+    void createGpuMeshlets(VkDeviceSize alignment);
+    void recordMeshletBuild(VkCommandBuffer cmdBuffer);
+    void editDemo();
+    void createCullPipeline();
+    void createCullBuffers();
+    void destroyCullBuffers();
+    void createDrawBuffers();
+    void destroyDrawBuffers();
+    void recordCull(VkCommandBuffer cmdBuffer, uint32_t currFrame, uint32_t phase);
+    void buildDrawList(uint32_t currFrame);
+    void destroyDrawListBuffers();
+    void createDepthPyramid();
+    void destroyDepthPyramid();
+    void createDepthReducePipeline();
+    void recordDepthPyramid(VkCommandBuffer cmdBuffer);
+    VkRenderPass createVisibilityRenderpass();
+    void createVisibilityResources();
+    void destroyVisibilityResources();
+    void recordShade(VkCommandBuffer cmdBuffer, uint32_t imageIndex, uint32_t currFrame);
+    void recordUpscale(VkCommandBuffer cmdBuffer, uint32_t imageIndex, VkImage image, VkImageLayout layout, VkExtent2D extent);
+    void createTaaPipeline();
+    void recordTemporalUpscale(VkCommandBuffer cmdBuffer, uint32_t imageIndex);
+    void updateRenderScale(uint32_t currFrame);
+    void createLightCullPipeline();
+    void createLightBuffers();
+    void destroyLightBuffers();
+    void recordLightCull(VkCommandBuffer cmdBuffer, uint32_t currFrame, bool async);
+    void createCounterBuffers();
+    void destroyCounterBuffers();
+    void recordCounterReset(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void recordCounterReadback(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void createLodPipeline();
+    void createLodBuffers();
+    void destroyLodBuffers();
+    void recordLodSelect(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void createRasterPipelines();
+    void createRasterBuffers();
+    void destroyRasterBuffers();
+    void pushRasterDescriptors(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void recordRasterClassify(VkCommandBuffer cmdBuffer, uint32_t currFrame);
+    void recordSoftwareRaster(VkCommandBuffer cmdBuffer, uint32_t currFrame);
 
     GLFWwindow* window;
     VkInstance instance;
@@ -46,11 +132,37 @@ private:
     VkQueue graphicsQueue;
     VkQueue presentQueue;
     VkQueue transferQueue;
+    VkQueue computeQueue = VK_NULL_HANDLE; // only with a compute family and timeline semaphores
     VkSwapchainKHR swapchain;
     VkFormat swapchainFormat;
     VkExtent2D swapchainExtent;
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
+    // dynamic resolution, the passes draw into the top left renderExtent of targets the size of the swapchain and
+    // resolve into sceneImage, which is blitted up into the swapchain image, so a new scale only changes the
+    // viewports and never recreates anything, the scale follows the GPU time of the frames against the budget
+    bool sceneUpscaled = false; // fixed at startup, the render passes resolve into sceneImage
+    VkImage sceneImage = VK_NULL_HANDLE;
+    VkDeviceMemory sceneImageMemory = VK_NULL_HANDLE;
+    VkImageView sceneImageView = VK_NULL_HANDLE;
+    VkExtent2D renderExtent{}; // of the frame being recorded
+    float renderScale = 1.0f; // per axis
+    std::vector<float> frameRenderScale; // per frame in flight, what it was rendered at, 0 until it was timed
+    // temporal upsampling, the projection is jittered every frame and taa.comp blends the scene image into a full
+    // resolution history reprojected through the depth buffer, the two histories take turns being read and written
+    std::array<VkImage, 2> historyImages{};
+    std::array<VkDeviceMemory, 2> historyImageMemory{};
+    std::array<VkImageView, 2> historyImageViews{};
+    uint32_t historyIndex = 0; // the one written next
+    bool historyValid = false; // the last frame was accumulated and the histories are in the general layout
+    glm::vec2 taaJitter = glm::vec2(0.0f); // of the frame being recorded, in render pixels
+    uint32_t taaFrame = 0; // position in the jitter sequence
+    glm::mat4 frameClip = glm::mat4(1.0f); // clip from object space of the frame being recorded, without the jitter
+    glm::mat4 previousClip = glm::mat4(1.0f); // and of the last frame accumulated
+    VkSampler taaSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout taaSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout taaPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline taaPipeline = VK_NULL_HANDLE;
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorSetLayout pushDescriptorSetLayout;
     VkDescriptorPool descriptorPool;
@@ -60,20 +172,203 @@ private:
     VkPipeline meshGfxPipeline;
     VkRenderPass renderpass;
     std::vector<VkFramebuffer> swapchainFramebuffers;
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    // the vertex streams, mesh.positions and mesh.attributes
+    VkBuffer positionBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory positionBufferMemory = VK_NULL_HANDLE;
+    VkBuffer attributeBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory attributeBufferMemory = VK_NULL_HANDLE;
+    VkDeviceSize positionBufferSize;
+    VkDeviceSize attributeBufferSize;
+    // depth prepass: the depth pipelines only read the position stream and write depth, the equal ones shade
+    // with depth writes off where the depth matches
+    VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline meshDepthPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline gfxEqualPipeline = VK_NULL_HANDLE;
+    VkPipeline meshEqualPipeline = VK_NULL_HANDLE;
+    // timestamps before the prepass, between the two passes and after shading, summed up until the title shows them
+    VkQueryPool prepassQueryPool = VK_NULL_HANDLE;
+    std::vector<bool> prepassTimed; // per frame in flight
+    double depthPrepassMs = 0.0;
+    double shadePassMs = 0.0;
+    uint32_t prepassFrames = 0;
     VkBuffer indexBuffer;
-    VkDeviceSize vertexBufferSize;
+    std::vector<MeshRange> meshRanges; // the mesh table, where every mesh is inside the pool's buffers
+    std::vector<uint32_t> meshGroupOffsets; // the index groups of mesh m are [meshGroupOffsets[m], meshGroupOffsets[m+1])
+    std::vector<Instance> instances;
+    VkBuffer instanceBuffer;
+    VkDeviceMemory instanceBufferMemory;
     VkDeviceMemory indexBufferMemory;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    std::vector<MeshletIndexGroup> indexGroups; // one vkCmdDrawIndexed each
     VkBuffer meshletBuffer;
     VkDeviceMemory meshletBufferMemory;
     VkDeviceSize meshletBufferSize;
+    BufferRange meshletHeaderRange;
+    BufferRange meshletVertexRange;
+    BufferRange meshletTriangleRange;
+    // GPU meshlet build, meshletCountBuffer doubles as the indirect mesh draw
+    VkDescriptorSetLayout meshletBuildSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout meshletBuildPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline meshletBuildPipeline = VK_NULL_HANDLE;
+    VkBuffer meshletCountBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory meshletCountBufferMemory = VK_NULL_HANDLE;
+    uint32_t gpuMeshletCount = 0;
+    // one per frame in flight, signaled once its command buffer is done, a flush waits for all of them
+    std::vector<VkFence> cmdBufferReady;
+    // [first, last) vertex and triangle ranges edited since the last flush
+    std::vector<std::pair<uint32_t, uint32_t>> dirtyVertices;
+    std::vector<std::pair<uint32_t, uint32_t>> dirtyTriangles;
+    uint32_t editCount = 0;
+    // compute culling for the vertex path, cullBuffer holds the bounds and one indexed draw per meshlet,
+    // the visible draws are compacted into visibleDrawBuffer and counted in drawCountBuffer
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    // the mesh table and the identity instance order the culled draws read instances through
+    VkBuffer drawBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory drawBufferMemory = VK_NULL_HANDLE;
+    BufferRange meshTableRange;
+    BufferRange instanceOrderRange;
+    // the draw list, rebuilt every frame into a persistently mapped buffer per frame in flight,
+    // which holds the sorted instance order followed by the indirect commands
+    std::vector<DrawPacket> drawPackets;
+    std::vector<DrawPacket> drawPacketScratch;
+    std::vector<DrawRun> drawRuns;
+    std::vector<DrawCall> drawCalls; // of the frame being recorded
+    DrawListStats drawListStats;
+    DrawListStats reportedDrawListStats; // what was printed last, the list is reported when its shape changes
+    std::vector<VkBuffer> drawListBuffers;
+    std::vector<VkDeviceMemory> drawListBufferMemory;
+    std::vector<void*> drawListBufferMapped;
+    std::vector<VkDeviceSize> drawListBufferSizes;
+    BufferRange drawListOrderRange;
+    BufferRange drawListCommandRange; // VkDrawIndexedIndirectCommand or MeshTaskDraw, depending on the path
+    VkBuffer cullBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory cullBufferMemory = VK_NULL_HANDLE;
+    BufferRange cullBoundsRange;
+    BufferRange cullDrawRange;
+    BufferRange cullVisibilityRange;
+    uint32_t cullDrawCapacity = 0; // meshlets times instances, summed over the meshes
+    VkBuffer visibleDrawBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory visibleDrawBufferMemory = VK_NULL_HANDLE;
+    VkBuffer drawCountBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory drawCountBufferMemory = VK_NULL_HANDLE;
+    // two pass occlusion culling, the pyramid is built from the early pass' depth and tested by the late cull
+    VkRenderPass earlyRenderpass;
+    VkRenderPass lateRenderpass;
+    VkImage depthPyramid;
+    VkDeviceMemory depthPyramidMemory;
+    VkImageView depthPyramidView;
+    std::vector<VkImageView> depthPyramidMips;
+    uint32_t depthPyramidWidth;
+    uint32_t depthPyramidHeight;
+    uint32_t depthPyramidLevels;
+    VkSampler depthPyramidSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout depthReduceSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout depthReducePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline depthReducePipeline = VK_NULL_HANDLE;
+    // visibility buffer mode, the mesh path writes (meshlet and triangle, instance) of every pixel single sampled,
+    // then a fullscreen pass in the forward render pass shades each pixel once from that
+    VkRenderPass visibilityRenderpass = VK_NULL_HANDLE;
+    VkFramebuffer visibilityFramebuffer = VK_NULL_HANDLE;
+    VkImage visibilityImage = VK_NULL_HANDLE;
+    VkDeviceMemory visibilityImageMemory = VK_NULL_HANDLE;
+    VkImageView visibilityImageView = VK_NULL_HANDLE;
+    VkImage visibilityDepthImage = VK_NULL_HANDLE;
+    VkDeviceMemory visibilityDepthImageMemory = VK_NULL_HANDLE;
+    VkImageView visibilityDepthImageView = VK_NULL_HANDLE;
+    VkPipeline visibilityPipeline = VK_NULL_HANDLE;
+    VkDescriptorSetLayout shadeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout shadePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline shadePipeline = VK_NULL_HANDLE;
+    // levels of detail on the mesh path, lod.comp picks a level per instance and appends it to the level's draws,
+    // lodBuffer holds the table, a copy of the draws and counts as they are at the start of a frame, the draws
+    // and counts of the frame and the instance order the draws read
+    std::vector<MeshLod> meshLods; // LOD_MAX_LEVELS rows per mesh, empty without --lod
+    std::streambuf* reportBuffer = nullptr; // stdout while std::cout goes to stderr, see --meshlet-report=json
+    VkDescriptorSetLayout lodSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout lodPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline lodPipeline = VK_NULL_HANDLE;
+    VkBuffer lodBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory lodBufferMemory = VK_NULL_HANDLE;
+    BufferRange lodTableRange;
+    BufferRange lodResetRange; // the draws and counts to start from, laid out like the two ranges below
+    BufferRange lodCommandRange;
+    BufferRange lodCountRange;
+    BufferRange lodOrderRange;
+    uint32_t lodCommandCount = 0;
+    float lodThreshold = 1.0f; // pixels a level may be off by on screen
+    // hybrid rasterization of the visibility buffer, rasterclassify.comp splits the meshlets by how many pixels their
+    // triangles cover, the mesh path draws the large ones from clusterBuffer, swraster.comp the small ones into
+    // swVisibilityBuffer with 64 bit atomics, and swresolve.comp merges that into visibilityImage
+    float swRasterThreshold = 0.0f; // pixels per triangle, 0 draws everything on the mesh path
+    bool bufferInt64Atomics = false;
+    bool visibilityDepthSampled = false; // the resolve compares against the mesh path's depth
+    uint32_t maxComputeWorkGroupCountX = 65535;
+    float timestampPeriod = 1.0f; // nanoseconds per timestamp tick
+    VkDeviceSize storageBufferAlignment = 1; // minStorageBufferOffsetAlignment, the draw list lays out ranges every frame
+    VkDescriptorSetLayout rasterSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout rasterPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline rasterClassifyPipeline = VK_NULL_HANDLE;
+    VkPipeline swRasterPipeline = VK_NULL_HANDLE;
+    VkPipeline swResolvePipeline = VK_NULL_HANDLE;
+    // the mesh path's clusters and then the compute rasterizer's, as (meshlet, instance)
+    VkBuffer clusterBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory clusterBufferMemory = VK_NULL_HANDLE;
+    uint32_t swRasterCapacity = 0;
+    // an indirect mesh draw and an indirect dispatch, the classification counts into their x
+    VkBuffer rasterCommandBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory rasterCommandBufferMemory = VK_NULL_HANDLE;
+    VkBuffer swVisibilityBuffer = VK_NULL_HANDLE; // depth << 32 | cluster << 7 | triangle per pixel
+    VkDeviceMemory swVisibilityBufferMemory = VK_NULL_HANDLE;
+    // timestamps around the mesh path and the compute rasterizer of every frame, summed up until the title shows them
+    VkQueryPool rasterQueryPool = VK_NULL_HANDLE;
+    std::vector<uint32_t> rasterTimedPasses; // per frame in flight, how many of the two passes were timed
+    double hwRasterMs = 0.0;
+    double swRasterMs = 0.0;
+    uint32_t hwRasterFrames = 0;
+    uint32_t swRasterFrames = 0;
+    // clustered forward lighting, lightcull.comp bins lightBuffer into the frame's grid (counts, then the lists) every
+    // frame, both are bound in set 0 so the fragment shaders of every path can read them, a grid per frame in flight
+    // lets the async compute queue bin the next frame while this one is still shaded
+    std::vector<Light> lights;
+    VkBuffer lightBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory lightBufferMemory = VK_NULL_HANDLE;
+    std::vector<VkBuffer> lightGridBuffers;
+    std::vector<VkDeviceMemory> lightGridBufferMemory;
+    VkPipelineLayout lightCullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline lightCullPipeline = VK_NULL_HANDLE;
+    VkQueryPool lightQueryPool = VK_NULL_HANDLE; // around the binning of every frame
+    std::vector<bool> lightCullTimed; // per frame in flight
+    double lightCullMs = 0.0;
+    uint32_t lightCullFrames = 0;
+    // async compute, the graphics submit waits for the binning at the fragment shaders only, each queue's timestamps
+    // are only compared with its own, so the two durations are reported side by side
+    std::vector<bool> asyncComputeTimed; // per frame in flight
+    double asyncGraphicsMs = 0.0; // the graphics queue's time in the frames whose lights were binned beside it
+    uint32_t asyncComputeFrames = 0;
+    // what the overlap buys is seen in the time between frames, the last 120 with async compute off and on are kept
+    // across toggles (A) so the two can be compared
+    std::vector<double> syncFrameTimes;
+    std::vector<double> asyncFrameTimes;
+    // pipeline counters, the cull pass and the mesh shader add to the frame's slot of counterBuffer, the end of the
+    // frame copies it into the mapped readback buffer, which is read once the slot's fence has signaled, the numbers
+    // are MAX_FRAMES_IN_FLIGHT frames old but never make the CPU wait
+    VkBuffer counterBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory counterBufferMemory = VK_NULL_HANDLE;
+    VkBuffer counterReadbackBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory counterReadbackBufferMemory = VK_NULL_HANDLE;
+    void* counterReadbackMapped = nullptr;
+    VkDeviceSize counterStride = 0; // between the slots of the frames in flight
+    std::vector<bool> countersWritten; // per frame in flight
+    PipelineCounters pipelineCounters{};
+    UniformBufferObject frameUbo{}; // what updateUniformBuffers wrote last, the cull pass needs the same matrices
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBufferMemory;
     std::vector<void*> uniformBufferMapped;
-    VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
-    VkImageView colorImageView;
+    VkImage colorImage = VK_NULL_HANDLE; // only when multisampling, at 1x the passes draw straight into their target
+    VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+    VkImageView colorImageView = VK_NULL_HANDLE;
     VkImage textureImage;
     VkDeviceMemory textureImageMemory;
     VkImageView textureImageView;
@@ -84,7 +379,12 @@ private:
     VkFormat depthFormat;
     uint32_t mipLevels;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    bool standardSampleLocations = false;
+    // mesh shader limits for the instanced draws, only y and the total matter as x is the meshlet
+    uint32_t maxMeshWorkGroupCount[3] = {65535, 65535, 65535};
+    uint32_t maxMeshWorkGroupTotalCount = 1 << 22;
     Mesh mesh;
+    EngineOptions options;
 
     bool isDeviceSuitable(VkPhysicalDevice dev);
     QueueFamilies getQueueFamilies(VkPhysicalDevice dev);
@@ -100,13 +400,13 @@ private:
     VkSemaphore createSemaphore();
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     void createBuffer(VkBuffer& buffer, VkDeviceMemory& memory, VkBufferUsageFlags usage, 
-        VkDeviceSize size, VkMemoryPropertyFlags properties);
+        VkDeviceSize size, VkMemoryPropertyFlags properties, bool shared = false);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     void createImage(VkImage& image, VkDeviceMemory& imageMemory, uint32_t width, uint32_t height, VkFormat format, 
         VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryProperty, uint32_t mipLevels, 
         VkSampleCountFlagBits samples);
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels = 1);
     void generateMipmaps(VkImage image, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels, VkFormat format);
     VkSampleCountFlagBits getMaxSamples();
     void createQueryPool();
@@ -124,6 +424,7 @@ private:
     };
 
     const int MAX_FRAMES_IN_FLIGHT = 3;
+    const float MIN_RENDER_SCALE = 0.5f; // per axis, dynamic resolution goes no lower
     const std::string MODEL_PATH = "../viking_room.obj";
     const std::string TEXTURE_PATH = "../viking_room.png";
     VkQueryPool queryPool;
@@ -132,4 +433,13 @@ private:
 
     bool MESH_SHADERS_SUPPORTED = false;
     bool MESH_SHADERS_ENABLED = false;
+    bool CULLING_ENABLED = true;
+    bool OCCLUSION_ENABLED = true;
+    bool TRIANGLE_CULLING_ENABLED = true;
+    bool VISIBILITY_ENABLED = false;
+    bool PREPASS_ENABLED = false;
+    bool ASYNC_COMPUTE_ENABLED = true;
+    bool LOD_ENABLED = true;
+    bool DYNAMIC_RESOLUTION_ENABLED = false;
+    bool TAA_ENABLED = false;
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "Lights.hpp"
+#include <random>
+
+void generateLights(std::vector<Light>& lights, uint32_t count, uint32_t instanceCount, uint32_t seed) {
+    lights.resize(count);
+    if (count == 0) return;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    // the grid is side instances 3 units apart, each about 2 units wide
+    uint32_t side = std::ceil(std::sqrt(double(std::max(1u, instanceCount))));
+    float extent = (side - 1) * 1.5f + 1.5f;
+    // about 8 lights overlap anywhere on the grid
+    float radius = std::clamp(extent * std::sqrt(32.0f / (3.14159265f * count)), 0.1f, 2.0f * extent);
+    for (uint32_t i=0; i<count; i++) {
+        Light& light = lights[i];
+        light.position = glm::vec3((unit(rng)*2.0f - 1.0f) * extent, (unit(rng)*2.0f - 1.0f) * extent, unit(rng)*2.0f - 0.5f);
+        light.radius = radius * (0.75f + 0.5f*unit(rng));
+        light.color = glm::vec3(0.2f + 0.8f*unit(rng), 0.2f + 0.8f*unit(rng), 0.2f + 0.8f*unit(rng)) * 2.0f;
+        light.spotCosine = -1.0f;
+        light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        light.padding = 0.0f;
+        if (i % 4 == 3) {
+            light.direction = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, -1.0f));
+            light.spotCosine = std::cos(glm::radians(30.0f + 20.0f*unit(rng)));
+        }
+    }
+}
+size_t binLights(const std::vector<Light>& lights, const glm::mat4& modelView, const glm::mat4& proj,
+    std::vector<uint32_t>& counts, std::vector<uint32_t>& indices) {
+    counts.assign(LIGHT_CLUSTER_COUNT, 0);
+    indices.resize(size_t(LIGHT_CLUSTER_COUNT) * LIGHT_CLUSTER_CAPACITY);
+    std::vector<glm::vec4> spheres(lights.size());
+    for (size_t i=0; i<lights.size(); i++) {
+        spheres[i] = glm::vec4(glm::vec3(modelView * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+    }
+    float znear = proj[3][2] / proj[2][2];
+    float zfar = proj[3][2] / (proj[2][2] + 1.0f);
+    glm::vec2 scale(1.0f / proj[0][0], 1.0f / proj[1][1]);
+    size_t dropped = 0;
+    for (uint32_t cluster=0; cluster<LIGHT_CLUSTER_COUNT; cluster++) {
+        uint32_t x = cluster % LIGHT_CLUSTERS_X;
+        uint32_t y = cluster / LIGHT_CLUSTERS_X % LIGHT_CLUSTERS_Y;
+        uint32_t z = cluster / (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y);
+        glm::vec2 ndcMin = glm::vec2(x, y) / glm::vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y) * 2.0f - 1.0f;
+        glm::vec2 ndcMax = glm::vec2(x + 1, y + 1) / glm::vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y) * 2.0f - 1.0f;
+        glm::vec3 boxMin(1e30f);
+        glm::vec3 boxMax(-1e30f);
+        for (uint32_t k=0; k<2; k++) {
+            float d = znear * std::pow(zfar / znear, float(z + k) / LIGHT_CLUSTERS_Z);
+            glm::vec2 a = ndcMin * scale * d;
+            glm::vec2 b = ndcMax * scale * d;
+            boxMin = glm::min(boxMin, glm::vec3(glm::min(a, b), -d));
+            boxMax = glm::max(boxMax, glm::vec3(glm::max(a, b), -d));
+        }
+        uint32_t& count = counts[cluster];
+        for (uint32_t i=0; i<spheres.size(); i++) {
+            glm::vec3 offset = glm::clamp(glm::vec3(spheres[i]), boxMin, boxMax) - glm::vec3(spheres[i]);
+            if (glm::dot(offset, offset) > spheres[i].w * spheres[i].w) continue;
+            if (count < LIGHT_CLUSTER_CAPACITY) indices[size_t(cluster) * LIGHT_CLUSTER_CAPACITY + count] = i;
+            else dropped++;
+            count++;
+        }
+    }
+    return dropped;
+}
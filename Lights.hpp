@@ -0,0 +1,19 @@
+#pragma once
+#include "config.hpp"
+
+// clustered forward lighting: the view frustum is cut into tiles on screen and exponential slices in depth,
+// lightcull.comp lists the lights reaching each cluster every frame and the fragment shaders only walk the list
+// of their own, the same numbers are in mesh.h
+const uint32_t LIGHT_CLUSTERS_X = 16;
+const uint32_t LIGHT_CLUSTERS_Y = 9;
+const uint32_t LIGHT_CLUSTERS_Z = 24;
+const uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+const uint32_t LIGHT_CLUSTER_CAPACITY = 128; // lights a fragment looks at at most
+
+// count lights spread over the instance grid of generateInstances, a quarter of them spot lights pointing down,
+// their radius shrinks as there are more of them so a point is reached by about the same number of lights
+void generateLights(std::vector<Light>& lights, uint32_t count, uint32_t instanceCount, uint32_t seed = 1);
+// what lightcull.comp computes, counts holds the lights reaching each cluster, indices the first
+// LIGHT_CLUSTER_CAPACITY of them per cluster, returns how many were dropped for the capacity
+size_t binLights(const std::vector<Light>& lights, const glm::mat4& modelView, const glm::mat4& proj,
+    std::vector<uint32_t>& counts, std::vector<uint32_t>& indices);
@@ -0,0 +1,91 @@
+#include "Lod.hpp"
+
+float simplifyMesh(const Mesh& mesh, float cellSize, std::vector<uint32_t>& indices) {
+    indices.clear();
+    if (mesh.vertices.empty()) return 0.0f;
+    glm::vec3 minPos = vertexPosition(mesh.vertices[0]);
+    for (const auto& vertex: mesh.vertices) minPos = glm::min(minPos, vertexPosition(vertex));
+
+    // 21 bits per axis, enough for a grid of two million cells on a side
+    auto cellKey = [&](const glm::vec3& pos) {
+        glm::uvec3 cell = glm::uvec3(glm::max((pos - minPos) / cellSize, glm::vec3(0.0f)));
+        cell = glm::min(cell, glm::uvec3((1u << 21) - 1));
+        return uint64_t(cell.x) | uint64_t(cell.y) << 21 | uint64_t(cell.z) << 42;
+    };
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::vector<uint32_t> vertexCell(mesh.vertices.size());
+    std::vector<glm::vec4> sums; // position sum and count per cell
+    for (uint32_t v=0; v<mesh.vertices.size(); v++) {
+        glm::vec3 pos = vertexPosition(mesh.vertices[v]);
+        auto [it, inserted] = cells.try_emplace(cellKey(pos), sums.size());
+        if (inserted) sums.push_back(glm::vec4(0.0f));
+        sums[it->second] += glm::vec4(pos, 1.0f);
+        vertexCell[v] = it->second;
+    }
+    std::vector<uint32_t> representative(sums.size(), ~0u);
+    std::vector<float> representativeDistance(sums.size(), std::numeric_limits<float>::max());
+    for (uint32_t v=0; v<mesh.vertices.size(); v++) {
+        uint32_t cell = vertexCell[v];
+        float distance = glm::distance(vertexPosition(mesh.vertices[v]), glm::vec3(sums[cell]) / sums[cell].w);
+        if (distance < representativeDistance[cell]) {
+            representativeDistance[cell] = distance;
+            representative[cell] = v;
+        }
+    }
+    float error = 0.0f;
+    for (uint32_t v=0; v<mesh.vertices.size(); v++) {
+        glm::vec3 pos = vertexPosition(mesh.vertices[representative[vertexCell[v]]]);
+        error = std::max(error, glm::distance(vertexPosition(mesh.vertices[v]), pos));
+    }
+
+    // a triangle is kept once, rotated so its smallest index comes first, which keeps the winding
+    std::unordered_set<glm::uvec3> kept;
+    for (size_t i=0; i+2<mesh.indices.size(); i+=3) {
+        glm::uvec3 triangle(representative[vertexCell[mesh.indices[i]]], representative[vertexCell[mesh.indices[i+1]]],
+            representative[vertexCell[mesh.indices[i+2]]]);
+        if (triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x) continue;
+        while (triangle.x > triangle.y || triangle.x > triangle.z) triangle = glm::uvec3(triangle.y, triangle.z, triangle.x);
+        if (!kept.insert(triangle).second) continue;
+        indices.insert(indices.end(), {triangle.x, triangle.y, triangle.z});
+    }
+    return error;
+}
+
+void buildLodLevels(const Mesh& mesh, std::vector<LodLevel>& levels, uint32_t minTriangles) {
+    levels.clear();
+    uint32_t triangleCount = mesh.indices.size()/3;
+    if (triangleCount < minTriangles) return;
+    // the first grid is about twice the average edge, cells then double until a level drops enough triangles
+    double edgeSum = 0.0;
+    for (size_t i=0; i+2<mesh.indices.size(); i+=3) {
+        glm::vec3 p0 = vertexPosition(mesh.vertices[mesh.indices[i]]);
+        glm::vec3 p1 = vertexPosition(mesh.vertices[mesh.indices[i+1]]);
+        edgeSum += glm::distance(p0, p1);
+    }
+    float cellSize = std::max(1e-4f, float(2.0 * edgeSum / triangleCount));
+    uint32_t previous = triangleCount;
+    for (int attempt=0; attempt<32 && levels.size() + 1 < LOD_MAX_LEVELS; attempt++, cellSize *= 2.0f) {
+        LodLevel level;
+        level.error = simplifyMesh(mesh, cellSize, level.indices);
+        uint32_t count = level.indices.size()/3;
+        if (count == 0) break;
+        if (count > previous * 3 / 4) continue; // not worth a level of its own
+        previous = count;
+        levels.push_back(std::move(level));
+        if (count < minTriangles) break;
+    }
+}
+
+glm::vec4 computeMeshSphere(const Mesh& mesh) {
+    if (mesh.vertices.empty()) return glm::vec4(0.0f);
+    glm::vec3 minPos = vertexPosition(mesh.vertices[0]);
+    glm::vec3 maxPos = minPos;
+    for (const auto& vertex: mesh.vertices) {
+        minPos = glm::min(minPos, vertexPosition(vertex));
+        maxPos = glm::max(maxPos, vertexPosition(vertex));
+    }
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.0f;
+    for (const auto& vertex: mesh.vertices) radius = std::max(radius, glm::distance(center, vertexPosition(vertex)));
+    return glm::vec4(center, radius);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Meshlets.hpp"
+
+// levels of detail per mesh, level 0 is the mesh itself, every further level is simplified from it
+// with a grid twice as coarse, so they only differ in their triangles and share the mesh's vertices
+const uint32_t LOD_MAX_LEVELS = 8;
+
+struct LodLevel {
+    std::vector<uint32_t> indices; // into the vertices of the mesh the level was built from
+    float error = 0.0f; // farthest any vertex of the mesh moved, in model units
+};
+
+// vertex clustering: the vertices falling into the same cell of a grid of cellSize collapse into the one closest to
+// the cell's mean, triangles that degenerate or come out twice are dropped, returns the farthest a vertex moved
+float simplifyMesh(const Mesh& mesh, float cellSize, std::vector<uint32_t>& indices);
+// levels 1 and up of mesh, each with about a quarter of the triangles of the one before, until a level has fewer than
+// minTriangles triangles or LOD_MAX_LEVELS levels are reached
+void buildLodLevels(const Mesh& mesh, std::vector<LodLevel>& levels, uint32_t minTriangles = 256);
+// sphere around the center of the mesh's bounding box, as (center, radius)
+glm::vec4 computeMeshSphere(const Mesh& mesh);
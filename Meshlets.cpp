@@ -0,0 +1,568 @@
+#include "Meshlets.hpp"
+#include <numeric>
+#include <thread>
+#include <atomic>
+
+void appendMeshlet(Mesh& mesh, const std::vector<uint32_t>& vertices, const std::vector<uint8_t>& triangles) {
+    // sort the vertices so that the deltas between neighbours are small and never negative,
+    // the triangles are remapped to the new local order
+    std::vector<uint8_t> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint8_t a, uint8_t b) { return vertices[a] < vertices[b]; });
+    std::vector<uint32_t> sorted(vertices.size());
+    std::vector<uint8_t> remap(vertices.size());
+    for (size_t i=0; i<order.size(); i++) {
+        sorted[i] = vertices[order[i]];
+        remap[order[i]] = i;
+    }
+
+    // all deltas of a meshlet have the same width, so every thread can find its own without decoding the rest
+    uint32_t maxDelta = 0;
+    for (size_t i=1; i<sorted.size(); i++) {
+        maxDelta = std::max(maxDelta, sorted[i] - sorted[i-1]);
+    }
+    uint32_t vertexBits = maxDelta < (1u << 8) ? 8 : maxDelta < (1u << 16) ? 16 : 32;
+
+    Meshlet meshlet{};
+    meshlet.vertexBase = sorted.empty() ? 0 : sorted[0];
+    meshlet.vertexOffset = mesh.meshletVertices.size();
+    meshlet.triangleOffset = mesh.meshletTriangles.size();
+    meshlet.vertexCount = sorted.size();
+    meshlet.triangleCount = triangles.size()/3;
+    meshlet.vertexBits = vertexBits;
+
+    // 8, 16 and 32 bit deltas never cross a word boundary
+    mesh.meshletVertices.resize(meshlet.vertexOffset + (sorted.size()*vertexBits + 31)/32, 0);
+    for (size_t i=0; i<sorted.size(); i++) {
+        uint32_t delta = i == 0 ? 0 : sorted[i] - sorted[i-1];
+        size_t bit = i*vertexBits;
+        mesh.meshletVertices[meshlet.vertexOffset + bit/32] |= delta << (bit%32);
+    }
+
+    // 18 bit triangles do, the upper bits then go to the low bits of the next word
+    size_t triangleCount = triangles.size()/3;
+    mesh.meshletTriangles.resize(meshlet.triangleOffset + (triangleCount*MESHLET_TRIANGLE_BITS + 31)/32, 0);
+    for (size_t i=0; i<triangleCount; i++) {
+        uint32_t packed = remap[triangles[i*3+0]] | remap[triangles[i*3+1]] << 6 | remap[triangles[i*3+2]] << 12;
+        size_t bit = i*MESHLET_TRIANGLE_BITS;
+        uint32_t* words = &mesh.meshletTriangles[meshlet.triangleOffset + bit/32];
+        words[0] |= packed << (bit%32);
+        if (bit%32 + MESHLET_TRIANGLE_BITS > 32) {
+            words[1] |= packed >> (32 - bit%32);
+        }
+    }
+
+    mesh.meshlets.push_back(meshlet);
+}
+void decodeMeshlet(const Mesh& mesh, const Meshlet& meshlet, std::vector<uint32_t>& vertices, std::vector<uint8_t>& triangles) {
+    vertices.resize(meshlet.vertexCount);
+    uint32_t mask = meshlet.vertexBits == 32 ? ~0u : (1u << meshlet.vertexBits) - 1;
+    uint32_t vertex = meshlet.vertexBase;
+    for (size_t i=0; i<vertices.size(); i++) {
+        size_t bit = i*meshlet.vertexBits;
+        vertex += (mesh.meshletVertices[meshlet.vertexOffset + bit/32] >> (bit%32)) & mask;
+        vertices[i] = vertex;
+    }
+
+    triangles.resize(meshlet.triangleCount*3);
+    for (size_t i=0; i<meshlet.triangleCount; i++) {
+        size_t bit = i*MESHLET_TRIANGLE_BITS;
+        const uint32_t* words = &mesh.meshletTriangles[meshlet.triangleOffset + bit/32];
+        uint32_t packed = words[0] >> (bit%32);
+        if (bit%32 + MESHLET_TRIANGLE_BITS > 32) {
+            packed |= words[1] << (32 - bit%32);
+        }
+        triangles[i*3+0] = packed & 63;
+        triangles[i*3+1] = (packed >> 6) & 63;
+        triangles[i*3+2] = (packed >> 12) & 63;
+    }
+}
+
+// streams is the mesh holding the meshlet's packed streams, vertices always come from mesh
+static MeshletBounds computeMeshletBounds(const Mesh& mesh, const Meshlet& meshlet, const Mesh& streams) {
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+    decodeMeshlet(streams, meshlet, vertices, triangles);
+    MeshletBounds bounds{};
+    if (vertices.empty()) {
+        bounds.coneCutoff = 1.0f;
+        return bounds;
+    }
+
+    // sphere around the center of the bounding box, not minimal but close and cheap
+    glm::vec3 minPos = vertexPosition(mesh.vertices[vertices[0]]);
+    glm::vec3 maxPos = minPos;
+    for (uint32_t v: vertices) {
+        glm::vec3 pos = vertexPosition(mesh.vertices[v]);
+        minPos = glm::min(minPos, pos);
+        maxPos = glm::max(maxPos, pos);
+    }
+    bounds.center = (minPos + maxPos) * 0.5f;
+    for (uint32_t v: vertices) {
+        bounds.radius = std::max(bounds.radius, glm::distance(bounds.center, vertexPosition(mesh.vertices[v])));
+    }
+
+    // the cone axis is the average face normal, its half angle is set by the normal furthest away from it
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for (size_t i=0; i<triangles.size(); i+=3) {
+        glm::vec3 p0 = vertexPosition(mesh.vertices[vertices[triangles[i+0]]]);
+        glm::vec3 p1 = vertexPosition(mesh.vertices[vertices[triangles[i+1]]]);
+        glm::vec3 p2 = vertexPosition(mesh.vertices[vertices[triangles[i+2]]]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f) continue; // degenerate triangles face nowhere
+        normals.push_back(normal / area);
+        axis += normal / area;
+    }
+    bounds.coneCutoff = 1.0f;
+    if (normals.empty() || glm::length(axis) == 0.0f) {
+        return bounds;
+    }
+    bounds.coneAxis = glm::normalize(axis);
+    float minDot = 1.0f;
+    for (const auto& normal: normals) {
+        minDot = std::min(minDot, glm::dot(normal, bounds.coneAxis));
+    }
+    // a cone of 90 degrees or more always has some triangle facing the camera
+    if (minDot > 0.0f) {
+        bounds.coneCutoff = std::sqrt(1.0f - minDot*minDot);
+    }
+    return bounds;
+}
+MeshletBounds computeMeshletBounds(const Mesh& mesh, const Meshlet& meshlet) {
+    return computeMeshletBounds(mesh, meshlet, mesh);
+}
+
+// greedily fills one meshlet with the triangles from firstTriangle on, until the next one would exceed
+// the vertex or triangle limit or lastTriangle is reached, returns the first triangle that didn't go in
+static uint32_t fillMeshlet(const std::vector<uint32_t>& indices, uint32_t firstTriangle, uint32_t lastTriangle,
+    std::vector<uint32_t>& meshletVertexList, std::vector<uint8_t>& meshletIndicesList) {
+    meshletVertexList.clear();
+    meshletIndicesList.clear();
+    // at most 64 entries, a linear scan is cheaper than any set
+    auto findVertex = [&](uint32_t globalIdx) -> int {
+        for (size_t i=0; i<meshletVertexList.size(); i++) {
+            if (meshletVertexList[i] == globalIdx) return i;
+        }
+        return -1;
+    };
+    uint32_t currentTriangle = firstTriangle;
+    while (currentTriangle < lastTriangle && meshletIndicesList.size()/3 < MESHLET_MAX_TRIANGLES) {
+        const uint32_t* triangle = &indices[currentTriangle*3];
+        // a vertex that appears twice in the same triangle is only added once
+        uint32_t newVertices = 0;
+        for (int k=0; k<3; k++) {
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if (!repeated && findVertex(triangle[k]) < 0) newVertices++;
+        }
+        if (meshletVertexList.size() + newVertices > MESHLET_MAX_VERTICES) {
+            break;
+        }
+        for (int k=0; k<3; k++) {
+            int local = findVertex(triangle[k]);
+            if (local < 0) {
+                local = meshletVertexList.size();
+                meshletVertexList.push_back(triangle[k]);
+            }
+            meshletIndicesList.push_back(local);
+        }
+        currentTriangle++;
+    }
+    return currentTriangle;
+}
+// meshletizes the triangles [firstTriangle, lastTriangle) in order
+static void buildChunk(const std::vector<uint32_t>& indices, uint32_t firstTriangle, uint32_t lastTriangle, Mesh& chunk) {
+    std::vector<uint32_t> meshletVertexList;
+    std::vector<uint8_t> meshletIndicesList;
+    uint32_t currentTriangle = firstTriangle;
+    while (currentTriangle < lastTriangle) {
+        currentTriangle = fillMeshlet(indices, currentTriangle, lastTriangle, meshletVertexList, meshletIndicesList);
+        appendMeshlet(chunk, meshletVertexList, meshletIndicesList);
+    }
+}
+void buildMeshlets(Mesh& mesh, uint32_t threadCount) {
+    uint32_t triangleCount = mesh.indices.size() / 3;
+    uint32_t chunkCount = (triangleCount + MESHLET_CHUNK_TRIANGLES - 1) / MESHLET_CHUNK_TRIANGLES;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(1u, std::min(threadCount, chunkCount));
+
+    // every chunk gets its own streams, threads pick the next free chunk until none are left
+    std::vector<Mesh> chunks(chunkCount);
+    std::atomic<uint32_t> nextChunk{0};
+    auto worker = [&]() {
+        for (uint32_t c = nextChunk++; c < chunkCount; c = nextChunk++) {
+            uint32_t firstTriangle = c * MESHLET_CHUNK_TRIANGLES;
+            uint32_t lastTriangle = std::min(triangleCount, firstTriangle + MESHLET_CHUNK_TRIANGLES);
+            buildChunk(mesh.indices, firstTriangle, lastTriangle, chunks[c]);
+            for (const auto& meshlet: chunks[c].meshlets) {
+                chunks[c].meshletBounds.push_back(computeMeshletBounds(mesh, meshlet, chunks[c]));
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i=1; i<threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    // concatenate in chunk order, which doesn't depend on the thread that built the chunk
+    size_t meshletCount = 0, vertexWords = 0, triangleWords = 0;
+    for (const auto& chunk: chunks) {
+        meshletCount += chunk.meshlets.size();
+        vertexWords += chunk.meshletVertices.size();
+        triangleWords += chunk.meshletTriangles.size();
+    }
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+    mesh.meshletBounds.clear();
+    mesh.meshletChunks.clear();
+    mesh.meshlets.reserve(meshletCount);
+    mesh.meshletBounds.reserve(meshletCount);
+    mesh.meshletVertices.reserve(vertexWords);
+    mesh.meshletTriangles.reserve(triangleWords);
+    for (const auto& chunk: chunks) {
+        uint32_t vertexOffset = mesh.meshletVertices.size();
+        uint32_t triangleOffset = mesh.meshletTriangles.size();
+        mesh.meshletChunks.push_back({uint32_t(mesh.meshlets.size()), uint32_t(chunk.meshlets.size()),
+            vertexOffset, uint32_t(chunk.meshletVertices.size()), triangleOffset, uint32_t(chunk.meshletTriangles.size())});
+        for (Meshlet meshlet: chunk.meshlets) {
+            meshlet.vertexOffset += vertexOffset;
+            meshlet.triangleOffset += triangleOffset;
+            mesh.meshlets.push_back(meshlet);
+        }
+        mesh.meshletBounds.insert(mesh.meshletBounds.end(), chunk.meshletBounds.begin(), chunk.meshletBounds.end());
+        mesh.meshletVertices.insert(mesh.meshletVertices.end(), chunk.meshletVertices.begin(), chunk.meshletVertices.end());
+        mesh.meshletTriangles.insert(mesh.meshletTriangles.end(), chunk.meshletTriangles.begin(), chunk.meshletTriangles.end());
+    }
+}
+
+// rebuilds the meshlets of chunk c that hold triangles [firstTriangle, lastTriangle), both inside the chunk
+static void rebuildChunkMeshlets(Mesh& mesh, uint32_t c, uint32_t firstTriangle, uint32_t lastTriangle, MeshletUpdate& update) {
+    MeshletChunk& chunk = mesh.meshletChunks[c];
+    uint32_t chunkStart = c * MESHLET_CHUNK_TRIANGLES;
+    uint32_t chunkEnd = std::min<uint32_t>(mesh.indices.size()/3, chunkStart + MESHLET_CHUNK_TRIANGLES);
+    uint32_t chunkMeshletEnd = chunk.firstMeshlet + chunk.meshletCount;
+
+    // find the meshlet holding firstTriangle, if the edit starts right at a meshlet the one before it
+    // stopped because of the edited triangle, so it has to be redone as well
+    uint32_t first = chunk.firstMeshlet, start = chunkStart;
+    uint32_t previous = first, previousStart = start;
+    while (first < chunkMeshletEnd && start + mesh.meshlets[first].triangleCount <= firstTriangle) {
+        if (mesh.meshlets[first].triangleCount > 0) {
+            previous = first;
+            previousStart = start;
+        }
+        start += mesh.meshlets[first].triangleCount;
+        first++;
+    }
+    if (start == firstTriangle && start > chunkStart) {
+        first = previous;
+        start = previousStart;
+    }
+
+    // meshletize again until a new meshlet ends where an old one did after the edit,
+    // from there on the greedy split makes the same choices as before
+    Mesh span;
+    std::vector<uint32_t> meshletVertexList;
+    std::vector<uint8_t> meshletIndicesList;
+    uint32_t last = chunkMeshletEnd, oldStart = start;
+    uint32_t currentTriangle = start;
+    for (uint32_t old = first; currentTriangle < chunkEnd; ) {
+        currentTriangle = fillMeshlet(mesh.indices, currentTriangle, chunkEnd, meshletVertexList, meshletIndicesList);
+        appendMeshlet(span, meshletVertexList, meshletIndicesList);
+        if (currentTriangle < lastTriangle) continue;
+        // empty meshlets left over from an earlier edit are taken back as well
+        while (old < chunkMeshletEnd && (oldStart < currentTriangle || mesh.meshlets[old].triangleCount == 0)) {
+            oldStart += mesh.meshlets[old].triangleCount;
+            old++;
+        }
+        if (oldStart == currentTriangle) {
+            last = old;
+            break;
+        }
+    }
+    for (const auto& meshlet: span.meshlets) {
+        span.meshletBounds.push_back(computeMeshletBounds(mesh, meshlet, span));
+    }
+    update.rebuiltMeshlets += span.meshlets.size();
+
+    // the old meshlets' words are contiguous, a meshlet's words end where the next one's start
+    uint32_t vertexBegin = mesh.meshlets[first].vertexOffset;
+    uint32_t triangleBegin = mesh.meshlets[first].triangleOffset;
+    uint32_t vertexEnd = last < chunkMeshletEnd ? mesh.meshlets[last].vertexOffset : chunk.vertexOffset + chunk.vertexWords;
+    uint32_t triangleEnd = last < chunkMeshletEnd ? mesh.meshlets[last].triangleOffset : chunk.triangleOffset + chunk.triangleWords;
+    uint32_t oldCount = last - first;
+
+    if (span.meshlets.size() <= oldCount && span.meshletVertices.size() <= vertexEnd - vertexBegin &&
+        span.meshletTriangles.size() <= triangleEnd - triangleBegin) {
+        // fits where the old meshlets were, unused headers become empty meshlets and unused words stay zero
+        for (uint32_t i=0; i<oldCount; i++) {
+            Meshlet meshlet{};
+            MeshletBounds bounds{};
+            bounds.coneCutoff = 1.0f;
+            meshlet.vertexOffset = vertexBegin + span.meshletVertices.size();
+            meshlet.triangleOffset = triangleBegin + span.meshletTriangles.size();
+            meshlet.vertexBits = 8;
+            if (i < span.meshlets.size()) {
+                meshlet = span.meshlets[i];
+                meshlet.vertexOffset += vertexBegin;
+                meshlet.triangleOffset += triangleBegin;
+                bounds = span.meshletBounds[i];
+            }
+            mesh.meshlets[first + i] = meshlet;
+            mesh.meshletBounds[first + i] = bounds;
+        }
+        std::copy(span.meshletVertices.begin(), span.meshletVertices.end(), mesh.meshletVertices.begin() + vertexBegin);
+        std::fill(mesh.meshletVertices.begin() + vertexBegin + span.meshletVertices.size(), mesh.meshletVertices.begin() + vertexEnd, 0);
+        std::copy(span.meshletTriangles.begin(), span.meshletTriangles.end(), mesh.meshletTriangles.begin() + triangleBegin);
+        std::fill(mesh.meshletTriangles.begin() + triangleBegin + span.meshletTriangles.size(), mesh.meshletTriangles.begin() + triangleEnd, 0);
+        update.meshlets.push_back({first, last});
+        update.vertexWords.push_back({vertexBegin, vertexEnd});
+        update.triangleWords.push_back({triangleBegin, triangleEnd});
+        return;
+    }
+
+    // doesn't fit, splice the new meshlets in and move everything after them
+    int64_t meshletShift = int64_t(span.meshlets.size()) - oldCount;
+    int64_t vertexShift = int64_t(span.meshletVertices.size()) - (vertexEnd - vertexBegin);
+    int64_t triangleShift = int64_t(span.meshletTriangles.size()) - (triangleEnd - triangleBegin);
+    for (auto& meshlet: span.meshlets) {
+        meshlet.vertexOffset += vertexBegin;
+        meshlet.triangleOffset += triangleBegin;
+    }
+    mesh.meshlets.erase(mesh.meshlets.begin() + first, mesh.meshlets.begin() + last);
+    mesh.meshlets.insert(mesh.meshlets.begin() + first, span.meshlets.begin(), span.meshlets.end());
+    mesh.meshletBounds.erase(mesh.meshletBounds.begin() + first, mesh.meshletBounds.begin() + last);
+    mesh.meshletBounds.insert(mesh.meshletBounds.begin() + first, span.meshletBounds.begin(), span.meshletBounds.end());
+    mesh.meshletVertices.erase(mesh.meshletVertices.begin() + vertexBegin, mesh.meshletVertices.begin() + vertexEnd);
+    mesh.meshletVertices.insert(mesh.meshletVertices.begin() + vertexBegin, span.meshletVertices.begin(), span.meshletVertices.end());
+    mesh.meshletTriangles.erase(mesh.meshletTriangles.begin() + triangleBegin, mesh.meshletTriangles.begin() + triangleEnd);
+    mesh.meshletTriangles.insert(mesh.meshletTriangles.begin() + triangleBegin, span.meshletTriangles.begin(), span.meshletTriangles.end());
+    for (size_t i=first + span.meshlets.size(); i<mesh.meshlets.size(); i++) {
+        mesh.meshlets[i].vertexOffset += vertexShift;
+        mesh.meshlets[i].triangleOffset += triangleShift;
+    }
+    chunk.meshletCount += meshletShift;
+    chunk.vertexWords += vertexShift;
+    chunk.triangleWords += triangleShift;
+    for (size_t i=c + 1; i<mesh.meshletChunks.size(); i++) {
+        mesh.meshletChunks[i].firstMeshlet += meshletShift;
+        mesh.meshletChunks[i].vertexOffset += vertexShift;
+        mesh.meshletChunks[i].triangleOffset += triangleShift;
+    }
+    update.resized = true;
+}
+void rebuildMeshlets(Mesh& mesh, uint32_t firstTriangle, uint32_t lastTriangle, MeshletUpdate& update) {
+    lastTriangle = std::min<uint32_t>(lastTriangle, mesh.indices.size()/3);
+    for (uint32_t c = firstTriangle / MESHLET_CHUNK_TRIANGLES; c < mesh.meshletChunks.size(); c++) {
+        uint32_t chunkStart = c * MESHLET_CHUNK_TRIANGLES;
+        if (chunkStart >= lastTriangle) break;
+        rebuildChunkMeshlets(mesh, c, std::max(firstTriangle, chunkStart),
+            std::min(lastTriangle, chunkStart + MESHLET_CHUNK_TRIANGLES), update);
+    }
+}
+void updateMeshletBounds(Mesh& mesh, uint32_t firstVertex, uint32_t lastVertex) {
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+    for (size_t i=0; i<mesh.meshlets.size(); i++) {
+        const Meshlet& meshlet = mesh.meshlets[i];
+        // vertexBase is the smallest vertex, so most meshlets are skipped without decoding
+        if (meshlet.vertexCount == 0 || meshlet.vertexBase >= lastVertex) continue;
+        decodeMeshlet(mesh, meshlet, vertices, triangles);
+        if (vertices.back() < firstVertex) continue;
+        auto it = std::lower_bound(vertices.begin(), vertices.end(), firstVertex);
+        if (it != vertices.end() && *it < lastVertex) {
+            mesh.meshletBounds[i] = computeMeshletBounds(mesh, meshlet);
+        }
+    }
+}
+
+bool buildMeshletIndices(const Mesh& mesh, std::vector<uint16_t>& indices, std::vector<MeshletIndexGroup>& groups) {
+    indices.clear();
+    groups.clear();
+    indices.reserve(mesh.indices.size());
+    return appendMeshletIndices(mesh, 0, mesh.meshlets.size(), indices, groups);
+}
+bool appendMeshletIndices(const Mesh& mesh, size_t firstMeshlet, size_t lastMeshlet,
+    std::vector<uint16_t>& indices, std::vector<MeshletIndexGroup>& groups) {
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+    // a group's smallest vertex is only known once it's closed, so its triangles wait here with global indices
+    std::vector<uint32_t> groupIndices;
+    uint32_t groupMin = ~0u, groupMax = 0;
+    auto closeGroup = [&]() {
+        if (groupIndices.empty()) return;
+        groups.push_back({uint32_t(indices.size()), uint32_t(groupIndices.size()), groupMin});
+        for (uint32_t index: groupIndices) indices.push_back(index - groupMin);
+        groupIndices.clear();
+        groupMin = ~0u;
+        groupMax = 0;
+    };
+    for (size_t m=firstMeshlet; m<lastMeshlet; m++) {
+        const Meshlet& meshlet = mesh.meshlets[m];
+        if (meshlet.triangleCount == 0) continue;
+        decodeMeshlet(mesh, meshlet, vertices, triangles);
+        // decoded vertices are sorted, so the ends are the meshlet's smallest and largest
+        if (vertices.back() - vertices.front() > 0xFFFF) return false;
+        if (std::max(groupMax, vertices.back()) - std::min(groupMin, vertices.front()) > 0xFFFF) closeGroup();
+        groupMin = std::min(groupMin, vertices.front());
+        groupMax = std::max(groupMax, vertices.back());
+        for (uint8_t local: triangles) groupIndices.push_back(vertices[local]);
+    }
+    closeGroup();
+    return true;
+}
+
+MeshRange appendMesh(Mesh& pool, const Mesh& mesh) {
+    MeshRange range{};
+    range.vertexOffset = pool.vertices.size();
+    range.vertexCount = mesh.vertices.size();
+    range.indexOffset = pool.indices.size();
+    range.indexCount = mesh.indices.size();
+    range.meshletCount = mesh.meshlets.size();
+    if (pool.vertices.empty() && pool.indices.empty()) {
+        pool.meshletChunks = mesh.meshletChunks;
+    } else {
+        pool.meshletChunks.clear();
+    }
+
+    pool.vertices.insert(pool.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    pool.indices.reserve(pool.indices.size() + mesh.indices.size());
+    for (uint32_t index: mesh.indices) pool.indices.push_back(range.vertexOffset + index);
+    range.meshletOffset = appendMeshlets(pool, mesh, range.vertexOffset);
+    return range;
+}
+uint32_t appendMeshlets(Mesh& pool, const Mesh& mesh, uint32_t vertexOffset) {
+    uint32_t meshletOffset = pool.meshlets.size();
+    uint32_t vertexWords = pool.meshletVertices.size();
+    uint32_t triangleWords = pool.meshletTriangles.size();
+    // the deltas are relative to the base, so moving the base moves every vertex of the meshlet
+    for (Meshlet meshlet: mesh.meshlets) {
+        meshlet.vertexBase += vertexOffset;
+        meshlet.vertexOffset += vertexWords;
+        meshlet.triangleOffset += triangleWords;
+        pool.meshlets.push_back(meshlet);
+    }
+    pool.meshletVertices.insert(pool.meshletVertices.end(), mesh.meshletVertices.begin(), mesh.meshletVertices.end());
+    pool.meshletTriangles.insert(pool.meshletTriangles.end(), mesh.meshletTriangles.begin(), mesh.meshletTriangles.end());
+    pool.meshletBounds.insert(pool.meshletBounds.end(), mesh.meshletBounds.begin(), mesh.meshletBounds.end());
+    return meshletOffset;
+}
+
+MeshletReport computeMeshletReport(const Mesh& mesh) {
+    MeshletReport report{};
+    report.meshletCount = mesh.meshlets.size();
+    if (mesh.meshlets.empty()) return report;
+
+    size_t payloadBits = 0;
+    for (const auto& meshlet: mesh.meshlets) {
+        report.triangleCount += meshlet.triangleCount;
+        report.vertexCount += meshlet.vertexCount;
+        report.vertexFill[std::min<size_t>(7, (std::max(1, int(meshlet.vertexCount)) - 1) / 8)]++;
+        report.triangleFill[std::min<size_t>(7, (std::max(1, int(meshlet.triangleCount)) - 1) / 16)]++;
+        payloadBits += meshlet.vertexCount*meshlet.vertexBits + meshlet.triangleCount*MESHLET_TRIANGLE_BITS;
+    }
+    report.verticesPerTriangle = float(report.vertexCount) / std::max<size_t>(1, report.triangleCount);
+
+    std::vector<float> radii;
+    radii.reserve(mesh.meshletBounds.size());
+    double radiusSum = 0.0;
+    for (const auto& bounds: mesh.meshletBounds) {
+        radii.push_back(bounds.radius);
+        radiusSum += bounds.radius;
+    }
+    if (!radii.empty()) {
+        std::sort(radii.begin(), radii.end());
+        auto percentile = [&](float p) { return radii[std::min(radii.size() - 1, size_t(p * radii.size()))]; };
+        report.radiusMin = radii.front();
+        report.radiusMax = radii.back();
+        report.radiusMean = radiusSum / radii.size();
+        report.radiusP50 = percentile(0.5f);
+        report.radiusP90 = percentile(0.9f);
+        report.radiusP99 = percentile(0.99f);
+    }
+
+    // a far away camera looking along -direction sees every meshlet along the same view vector,
+    // so a meshlet is culled if that vector lies inside its backfacing cone
+    const int DIRECTIONS = 64;
+    size_t usable = 0;
+    double culledMeshlets = 0.0, culledTriangles = 0.0;
+    for (size_t i=0; i<mesh.meshletBounds.size(); i++) {
+        const auto& bounds = mesh.meshletBounds[i];
+        if (bounds.coneCutoff >= 1.0f) continue;
+        usable++;
+        size_t culled = 0;
+        for (int d=0; d<DIRECTIONS; d++) {
+            // points spread evenly over the sphere (fibonacci lattice)
+            float z = 1.0f - (2.0f*d + 1.0f) / DIRECTIONS;
+            float r = std::sqrt(1.0f - z*z);
+            float phi = d * 2.39996323f;
+            glm::vec3 viewDir(-r*std::cos(phi), -r*std::sin(phi), -z);
+            if (glm::dot(viewDir, bounds.coneAxis) >= bounds.coneCutoff) culled++;
+        }
+        culledMeshlets += double(culled) / DIRECTIONS;
+        culledTriangles += double(culled) / DIRECTIONS * mesh.meshlets[i].triangleCount;
+    }
+    report.coneUsable = float(usable) / mesh.meshlets.size();
+    report.coneCulledMeshlets = culledMeshlets / mesh.meshlets.size();
+    report.coneCulledTriangles = culledTriangles / std::max<size_t>(1, report.triangleCount);
+
+    report.totalBytes = sizeof(Meshlet)*mesh.meshlets.size() + sizeof(uint32_t)*mesh.meshletVertices.size() +
+        sizeof(uint32_t)*mesh.meshletTriangles.size();
+    // every field of the header but the padding byte carries data
+    report.paddingBytes = report.totalBytes - (sizeof(Meshlet) - 1)*mesh.meshlets.size() - payloadBits/8;
+    report.fixedLayoutBytes = (sizeof(uint32_t)*64 + sizeof(uint8_t)*126*3 + 2)*mesh.meshlets.size();
+    return report;
+}
+void printMeshletReport(const MeshletReport& report, std::ostream& out, bool json) {
+    auto printArray = [&](const std::array<size_t, 8>& values) {
+        for (size_t i=0; i<values.size(); i++) {
+            out << (i ? ", " : "") << values[i];
+        }
+    };
+    if (json) {
+        out << "{\n";
+        out << "  \"meshlets\": " << report.meshletCount << ",\n";
+        out << "  \"triangles\": " << report.triangleCount << ",\n";
+        out << "  \"meshletVertices\": " << report.vertexCount << ",\n";
+        out << "  \"vertexFill\": {\"bucketSize\": 8, \"counts\": [";
+        printArray(report.vertexFill);
+        out << "]},\n";
+        out << "  \"triangleFill\": {\"bucketSize\": 16, \"counts\": [";
+        printArray(report.triangleFill);
+        out << "]},\n";
+        out << "  \"verticesPerTriangle\": " << report.verticesPerTriangle << ",\n";
+        out << "  \"radius\": {\"min\": " << report.radiusMin << ", \"mean\": " << report.radiusMean
+            << ", \"p50\": " << report.radiusP50 << ", \"p90\": " << report.radiusP90
+            << ", \"p99\": " << report.radiusP99 << ", \"max\": " << report.radiusMax << "},\n";
+        out << "  \"cone\": {\"usable\": " << report.coneUsable << ", \"culledMeshlets\": " << report.coneCulledMeshlets
+            << ", \"culledTriangles\": " << report.coneCulledTriangles << "},\n";
+        out << "  \"bytes\": {\"total\": " << report.totalBytes << ", \"padding\": " << report.paddingBytes
+            << ", \"fixedLayout\": " << report.fixedLayoutBytes << "}\n";
+        out << "}" << std::endl;
+        return;
+    }
+    out << "Meshlets: " << report.meshletCount << ", triangles: " << report.triangleCount
+        << ", meshlet vertices: " << report.vertexCount << std::endl;
+    out << "Vertex fill (8 per bucket): ";
+    printArray(report.vertexFill);
+    out << std::endl << "Triangle fill (16 per bucket): ";
+    printArray(report.triangleFill);
+    out << std::endl << std::fixed << std::setprecision(3);
+    out << "Vertices per triangle: " << report.verticesPerTriangle << std::endl;
+    out << "Bounding sphere radius: min " << report.radiusMin << ", mean " << report.radiusMean
+        << ", p50 " << report.radiusP50 << ", p90 " << report.radiusP90 << ", p99 " << report.radiusP99
+        << ", max " << report.radiusMax << std::endl;
+    out << "Cone culling: " << report.coneUsable*100.0f << "% usable, " << report.coneCulledMeshlets*100.0f
+        << "% meshlets / " << report.coneCulledTriangles*100.0f << "% triangles culled on average" << std::endl;
+    out << "Bytes: " << report.totalBytes << " total, " << report.paddingBytes << " padding, "
+        << report.fixedLayoutBytes << " with the fixed layout" << std::endl;
+    out << std::defaultfloat;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "config.hpp"
+#include <ostream>
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 126;
+const uint32_t MESHLET_TRIANGLE_BITS = 18; // 3 local indices of 6 bits each
+// the index stream is split into chunks of this many triangles that are meshletized independently,
+// the split doesn't depend on the number of threads, so neither does the result
+const uint32_t MESHLET_CHUNK_TRIANGLES = 1 << 16;
+
+// builds the meshlets of mesh.indices and their bounds on threadCount threads, 0 means one per hardware thread
+void buildMeshlets(Mesh& mesh, uint32_t threadCount = 0);
+// element ranges [first, last) of the meshlet arrays that an edit rewrote, so only those have to be uploaded
+struct MeshletUpdate {
+    std::vector<std::pair<size_t, size_t>> meshlets; // same range in meshletBounds
+    std::vector<std::pair<size_t, size_t>> vertexWords;
+    std::vector<std::pair<size_t, size_t>> triangleWords;
+    size_t rebuiltMeshlets = 0;
+    bool resized = false; // the new meshlets didn't fit in place and everything after them moved
+};
+// redoes the meshlets holding triangles [firstTriangle, lastTriangle) after mesh.indices changed there,
+// the greedy split restarts at the first affected meshlet and stops once it lines up with the old split again
+void rebuildMeshlets(Mesh& mesh, uint32_t firstTriangle, uint32_t lastTriangle, MeshletUpdate& update);
+// recomputes the bounds of the meshlets using any vertex in [firstVertex, lastVertex) after mesh.vertices changed there
+void updateMeshletBounds(Mesh& mesh, uint32_t firstVertex, uint32_t lastVertex);
+// consecutive meshlets drawn by one vkCmdDrawIndexed, their 16 bit indices are relative to vertexOffset
+struct MeshletIndexGroup {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexOffset;
+};
+// writes the meshlets' triangles out as an index buffer in meshlet order, so the vertex path reads vertices
+// in the same order as the mesh path, groups are cut where the vertices no longer fit in 16 bits,
+// returns false if a single meshlet already spans more than that
+bool buildMeshletIndices(const Mesh& mesh, std::vector<uint16_t>& indices, std::vector<MeshletIndexGroup>& groups);
+// same for meshlets [firstMeshlet, lastMeshlet) only, appending to indices and groups, groups never cross the range
+bool appendMeshletIndices(const Mesh& mesh, size_t firstMeshlet, size_t lastMeshlet,
+    std::vector<uint16_t>& indices, std::vector<MeshletIndexGroup>& groups);
+// bounding sphere and normal cone of one meshlet, computed from mesh.vertices
+MeshletBounds computeMeshletBounds(const Mesh& mesh, const Meshlet& meshlet);
+
+// how well the builder did, to tune it against data instead of guesses
+struct MeshletReport {
+    size_t meshletCount = 0;
+    size_t triangleCount = 0;
+    size_t vertexCount = 0; // sum over meshlets, shared vertices count once per meshlet
+    std::array<size_t, 8> vertexFill{}; // meshlets with 1-8, 9-16, ..., 57-64 vertices
+    std::array<size_t, 8> triangleFill{}; // meshlets with 1-16, 17-32, ..., 113-126 triangles
+    float verticesPerTriangle = 0.0f;
+    // bounding sphere radius percentiles, in model units
+    float radiusMin = 0.0f, radiusMean = 0.0f, radiusP50 = 0.0f, radiusP90 = 0.0f, radiusP99 = 0.0f, radiusMax = 0.0f;
+    float coneUsable = 0.0f; // fraction of meshlets whose cone can cull at all
+    float coneCulledMeshlets = 0.0f; // fraction of meshlets cone culled, averaged over view directions all around the mesh
+    float coneCulledTriangles = 0.0f; // same, weighted by triangle count
+    size_t totalBytes = 0; // headers and both streams, as uploaded
+    size_t paddingBytes = 0; // part of totalBytes that carries no data (header padding, unused bits in the last word)
+    size_t fixedLayoutBytes = 0; // what 64 vertex/126 triangle meshlets would take
+};
+MeshletReport computeMeshletReport(const Mesh& mesh);
+void printMeshletReport(const MeshletReport& report, std::ostream& out, bool json);
+
+// encodes one meshlet into the packed streams of the mesh
+// vertices are the global indices of its unique vertices, triangles are 3 indices into vertices per triangle
+void appendMeshlet(Mesh& mesh, const std::vector<uint32_t>& vertices, const std::vector<uint8_t>& triangles);
+// appends mesh, meshlets included, to the geometry pool, indices and meshlet headers are rebased onto the pool
+// chunks are only kept for a pool of one mesh, their triangle ranges are counted from the start of the index buffer
+MeshRange appendMesh(Mesh& pool, const Mesh& mesh);
+// appends only the meshlets of mesh, bounds included, whose vertices are already in the pool at vertexOffset,
+// e.g. a level of detail of a mesh in the pool, returns the index of the first one
+uint32_t appendMeshlets(Mesh& pool, const Mesh& mesh, uint32_t vertexOffset);
+// inverse of appendMeshlet, vertices come back sorted, so the local indices differ from the ones appended
+void decodeMeshlet(const Mesh& mesh, const Meshlet& meshlet, std::vector<uint32_t>& vertices, std::vector<uint8_t>& triangles);
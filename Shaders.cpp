@@ -1,17 +1,26 @@
 #include "Engine.hpp"
 void Engine::createDescriptorSetLayout() {
     // describes the descriptor set to be bounded
-    std::array<VkDescriptorSetLayoutBinding, 2> bindLayoutBinding{};
+    std::array<VkDescriptorSetLayoutBinding, 4> bindLayoutBinding{};
     bindLayoutBinding[0].binding = 0; // referenced in the shader
     bindLayoutBinding[0].descriptorCount = 1; // it is possible for a shader variable to represent an array of UBOs
     bindLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindLayoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    bindLayoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT |
+        VK_SHADER_STAGE_COMPUTE_BIT;
     bindLayoutBinding[0].pImmutableSamplers = nullptr;
     bindLayoutBinding[1].binding = 1;
     bindLayoutBinding[1].descriptorCount = 1;
     bindLayoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     bindLayoutBinding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     bindLayoutBinding[1].pImmutableSamplers = nullptr;
+    // the lights and the light clusters, written by lightcull.comp and read by every fragment shader that shades
+    for (uint32_t i=2; i<4; i++) {
+        bindLayoutBinding[i].binding = i;
+        bindLayoutBinding[i].descriptorCount = 1;
+        bindLayoutBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindLayoutBinding[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        bindLayoutBinding[i].pImmutableSamplers = nullptr;
+    }
 
     // tells the pipeline what kind of descriptor sets to expect
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -21,22 +30,38 @@ void Engine::createDescriptorSetLayout() {
     VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
 
     // this should be a separate set as we are supplying a flag for push descriptors
-    std::array<VkDescriptorSetLayoutBinding, 2> pushLayoutBinding{};
-    pushLayoutBinding[0].binding = 0;
-    pushLayoutBinding[0].descriptorCount = 1;
-    pushLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    pushLayoutBinding[0].pImmutableSamplers = nullptr;
-    pushLayoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_MESH_BIT_EXT;
-    pushLayoutBinding[1].binding = 1;
-    pushLayoutBinding[1].descriptorCount = 1;
-    pushLayoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    pushLayoutBinding[1].stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT;
-    pushLayoutBinding[1].pImmutableSamplers = nullptr;
-
-    descriptorSetLayoutInfo.bindingCount = MESH_SHADERS_SUPPORTED ? pushLayoutBinding.size() : 1;
+    // binding 0 is the position stream, 1 the attribute stream, 2 the instances, 3 the instance order, 4-6 are the
+    // meshlet headers, vertex stream and triangle stream, 7 the mesh shader draws, 8 the frame's pipeline counters
+    std::array<VkDescriptorSetLayoutBinding, 9> pushLayoutBinding{};
+    for (uint32_t i=0; i<pushLayoutBinding.size(); i++) {
+        pushLayoutBinding[i].binding = i;
+        pushLayoutBinding[i].descriptorCount = 1;
+        pushLayoutBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pushLayoutBinding[i].stageFlags = i < 4 ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_MESH_BIT_EXT;
+        pushLayoutBinding[i].pImmutableSamplers = nullptr;
+    }
+
+    descriptorSetLayoutInfo.bindingCount = MESH_SHADERS_SUPPORTED ? pushLayoutBinding.size() : 4;
     descriptorSetLayoutInfo.pBindings = pushLayoutBinding.data();
     descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
     VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &pushDescriptorSetLayout));
+
+    if (MESH_SHADERS_SUPPORTED) {
+        // shading from the visibility buffer: both vertex streams, instances, the three meshlet sections and the
+        // visibility buffer
+        std::array<VkDescriptorSetLayoutBinding, 7> shadeLayoutBinding{};
+        for (uint32_t i=0; i<shadeLayoutBinding.size(); i++) {
+            shadeLayoutBinding[i].binding = i;
+            shadeLayoutBinding[i].descriptorCount = 1;
+            shadeLayoutBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            shadeLayoutBinding[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shadeLayoutBinding[i].pImmutableSamplers = nullptr;
+        }
+        shadeLayoutBinding[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorSetLayoutInfo.bindingCount = shadeLayoutBinding.size();
+        descriptorSetLayoutInfo.pBindings = shadeLayoutBinding.data();
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &shadeSetLayout));
+    }
 }
 void Engine::createGraphicsPipeline() {
     auto vertCode = readFile("../shader.vert.spv");
@@ -125,10 +150,15 @@ void Engine::createGraphicsPipeline() {
     colorBlendInfo.attachmentCount = 1;
     colorBlendInfo.pAttachments = &colorBlendAttachment;
 
+    // per triangle culling settings of the mesh shader
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshConstants);
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    pipelineLayoutInfo.pushConstantRangeCount = MESH_SHADERS_SUPPORTED ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     pipelineLayoutInfo.setLayoutCount = 2;
     VkDescriptorSetLayout layouts[] = {descriptorSetLayout, pushDescriptorSetLayout};
     pipelineLayoutInfo.pSetLayouts = layouts;
@@ -160,6 +190,29 @@ void Engine::createGraphicsPipeline() {
     pipelineInfo.basePipelineHandle = nullptr; // in case we want to derive this pipeline from an already existing one
     VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &gfxPipeline));
 
+    // depth prepass: the position only vertex shader and no fragment shader, nothing but depth is written
+    auto depthCode = readFile("../depth.vert.spv");
+    VkShaderModule depthShaderModule = createShaderModule(depthCode);
+    VkPipelineShaderStageCreateInfo depthVertInfo = vertInfo;
+    depthVertInfo.module = depthShaderModule;
+    colorBlendAttachment.colorWriteMask = 0;
+    msaaInfo.sampleShadingEnable = VK_FALSE;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &depthVertInfo;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &depthPrepassPipeline));
+    // the shading pass after it, the depth is final so only the fragments that made it are shaded, both vertex
+    // shaders mark gl_Position invariant so the depths come out equal
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    msaaInfo.sampleShadingEnable = VK_TRUE;
+    pipelineInfo.stageCount = shaderStageInfos.size();
+    pipelineInfo.pStages = shaderStageInfos.data();
+    depthInfo.depthWriteEnable = VK_FALSE;
+    depthInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &gfxEqualPipeline));
+    depthInfo.depthWriteEnable = VK_TRUE;
+    depthInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
     if (MESH_SHADERS_SUPPORTED) {
         auto meshCode = readFile("../shader.mesh.spv");
         VkShaderModule meshShaderModule = createShaderModule(meshCode);
@@ -171,12 +224,406 @@ void Engine::createGraphicsPipeline() {
         pipelineInfo.pStages = shaderStageInfos.data();
         
         VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &meshGfxPipeline));
+
+        // the same two prepass pipelines for the mesh path, DEPTH_ONLY has the mesh shader read the position
+        // stream and skip the attributes
+        VkBool32 depthOnly = VK_TRUE;
+        VkSpecializationMapEntry depthOnlyEntry{0, 0, sizeof(VkBool32)};
+        VkSpecializationInfo depthOnlyInfo{1, &depthOnlyEntry, sizeof(VkBool32), &depthOnly};
+        VkPipelineShaderStageCreateInfo meshDepthInfo = vertInfo;
+        meshDepthInfo.pSpecializationInfo = &depthOnlyInfo;
+        colorBlendAttachment.colorWriteMask = 0;
+        msaaInfo.sampleShadingEnable = VK_FALSE;
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &meshDepthInfo;
+        VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &meshDepthPrepassPipeline));
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        msaaInfo.sampleShadingEnable = VK_TRUE;
+        pipelineInfo.stageCount = shaderStageInfos.size();
+        pipelineInfo.pStages = shaderStageInfos.data();
+        depthInfo.depthWriteEnable = VK_FALSE;
+        depthInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &meshEqualPipeline));
+        depthInfo.depthWriteEnable = VK_TRUE;
+        depthInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        // visibility buffer: the same mesh shader writes triangle ids into a single sampled target, a fragment
+        // shader that only passes ids on has nothing to gain from running per sample
+        auto visibilityCode = readFile("../visibility.frag.spv");
+        VkShaderModule visibilityShaderModule = createShaderModule(visibilityCode);
+        shaderStageInfos[1].module = visibilityShaderModule;
+        msaaInfo.sampleShadingEnable = VK_FALSE;
+        msaaInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        pipelineInfo.renderPass = visibilityRenderpass;
+        VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &visibilityPipeline));
+
+        // shading: a fullscreen triangle in the forward render pass, once per pixel as sample shading stays off
+        auto shadeVertCode = readFile("../shade.vert.spv");
+        auto shadeFragCode = readFile("../shade.frag.spv");
+        VkShaderModule shadeVertShaderModule = createShaderModule(shadeVertCode);
+        VkShaderModule shadeFragShaderModule = createShaderModule(shadeFragCode);
+        shaderStageInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStageInfos[0].module = shadeVertShaderModule;
+        shaderStageInfos[1].module = shadeFragShaderModule;
+        msaaInfo.rasterizationSamples = msaaSamples;
+        rasterInfo.cullMode = VK_CULL_MODE_NONE;
+        depthInfo.depthTestEnable = VK_FALSE;
+        depthInfo.depthWriteEnable = VK_FALSE;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        VkDescriptorSetLayout shadeLayouts[] = {descriptorSetLayout, shadeSetLayout};
+        pipelineLayoutInfo.pSetLayouts = shadeLayouts;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &shadePipelineLayout));
+        pipelineInfo.layout = shadePipelineLayout;
+        pipelineInfo.renderPass = renderpass;
+        VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &shadePipeline));
+
+        vkDestroyShaderModule(device, shadeFragShaderModule, nullptr);
+        vkDestroyShaderModule(device, shadeVertShaderModule, nullptr);
+        vkDestroyShaderModule(device, visibilityShaderModule, nullptr);
         vkDestroyShaderModule(device, meshShaderModule, nullptr);
     }
 
+    vkDestroyShaderModule(device, depthShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
+void Engine::createMeshletBuildPipeline() {
+    if (!options.gpuMeshlets) return;
+    // index buffer, meshlet headers, vertex stream, triangle stream and counters, all pushed when recording
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &meshletBuildSetLayout));
+
+    // the triangle count is the only input that isn't a buffer
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &meshletBuildSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &meshletBuildPipelineLayout));
+
+    auto compCode = readFile("../meshlets.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = meshletBuildPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &meshletBuildPipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+void Engine::createCullPipeline() {
+    // the GPU meshlet build has no bounds to cull with
+    if (options.gpuMeshlets) return;
+    // bounds, draws, visible draws, their count, visibility, the depth pyramid, the instances, the mesh table and
+    // the frame's pipeline counters
+    std::array<VkDescriptorSetLayoutBinding, 9> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &cullSetLayout));
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout));
+
+    auto compCode = readFile("../cull.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &cullPipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+void Engine::createRasterPipelines() {
+    // the classification needs the meshlet bounds of the cull pass, the rasterizer 64 bit atomics,
+    // and the resolve the mesh path's depth
+    if (!MESH_SHADERS_SUPPORTED || cullPipeline == VK_NULL_HANDLE) return;
+    if (!bufferInt64Atomics || !visibilityDepthSampled) {
+        std::cout << "Hybrid rasterization: not available, it needs 64 bit buffer atomics and a depth buffer that can be sampled" << std::endl;
+        return;
+    }
+    // bounds, instances, mesh table, the three meshlet sections, vertices, clusters, the indirect commands,
+    // the compute rasterizer's visibility, the visibility buffer and the mesh path's depth
+    std::array<VkDescriptorSetLayoutBinding, 12> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[11].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &rasterSetLayout));
+
+    // the matrices come from the uniform buffer of set 0, like on the mesh path
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(RasterConstants);
+    VkDescriptorSetLayout layouts[] = {descriptorSetLayout, rasterSetLayout};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = layouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &rasterPipelineLayout));
+
+    std::array<std::pair<const char*, VkPipeline*>, 3> stages = {{
+        {"../rasterclassify.comp.spv", &rasterClassifyPipeline},
+        {"../swraster.comp.spv", &swRasterPipeline},
+        {"../swresolve.comp.spv", &swResolvePipeline},
+    }};
+    for (const auto& [path, pipeline]: stages) {
+        auto compCode = readFile(path);
+        VkShaderModule compShaderModule = createShaderModule(compCode);
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = rasterPipelineLayout;
+        VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, pipeline));
+        vkDestroyShaderModule(device, compShaderModule, nullptr);
+    }
+}
+void Engine::createLightCullPipeline() {
+    if (options.lights == 0) return;
+    // everything is in set 0
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &lightCullPipelineLayout));
+
+    auto compCode = readFile("../lightcull.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = lightCullPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &lightCullPipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+void Engine::createLodPipeline() {
+    // the levels are only drawn by the mesh path
+    if (meshLods.empty()) return;
+    if (!MESH_SHADERS_SUPPORTED) {
+        std::cout << "Levels of detail: not available, they are drawn by the mesh shader path" << std::endl;
+        return;
+    }
+    // instances, mesh table, level table, the level draws, instances per level and the instance order
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &lodSetLayout));
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(LodConstants);
+    VkDescriptorSetLayout layouts[] = {descriptorSetLayout, lodSetLayout};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = layouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &lodPipelineLayout));
+
+    auto compCode = readFile("../lod.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = lodPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &lodPipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+void Engine::createDepthReducePipeline() {
+    // the pyramid is read by the cull pass, without it there is nothing to do
+    if (cullPipeline == VK_NULL_HANDLE) return;
+    // level 0 reads the depth buffer, which needs a format that can be sampled
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(pDevice, depthFormat, &props);
+    if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        std::cout << "Occlusion culling: not available, the depth buffer can't be sampled" << std::endl;
+        return;
+    }
+
+    // depth buffer, pyramid as a whole and the level being written
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &depthReduceSetLayout));
+
+    // size of the level and its index
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t)*3;
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &depthReduceSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &depthReducePipelineLayout));
+
+    // a single sampled depth buffer can't be bound as multisampled, see depth.h
+    auto compCode = readFile(msaaSamples == VK_SAMPLE_COUNT_1_BIT ? "../depthreduce_1x.comp.spv" : "../depthreduce.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = depthReducePipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &depthReducePipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+void Engine::createTaaPipeline() {
+    if (!options.taa || !sceneUpscaled) return;
+    // the reprojection reads the depth buffer like the depth pyramid does
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(pDevice, depthFormat, &props);
+    if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        std::cout << "Temporal upsampling: not available, the depth buffer can't be sampled" << std::endl;
+        return;
+    }
+
+    // scene, depth buffer, the history read and the one written
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t i=0; i<bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    descriptorSetLayoutInfo.bindingCount = bindings.size();
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &taaSetLayout));
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(TaaConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &taaSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &taaPipelineLayout));
+
+    auto compCode = readFile(msaaSamples == VK_SAMPLE_COUNT_1_BIT ? "../taa_1x.comp.spv" : "../taa.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = taaPipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &taaPipeline));
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+
+    // the history is read between its pixels, the scene and the depth only with texelFetch
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &taaSampler));
+    TAA_ENABLED = true;
+}
 VkShaderModule Engine::createShaderModule(std::vector<char> code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
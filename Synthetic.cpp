@@ -0,0 +1,215 @@
+#include "Synthetic.hpp"
+#include <map>
+#include <random>
+
+static Vertex makeVertex(glm::vec3 position, glm::vec3 normal, glm::vec2 texCoords) {
+    Vertex vertex{};
+    vertex.x = floatToHalf(position.x);
+    vertex.y = floatToHalf(position.y);
+    vertex.z = floatToHalf(position.z);
+    // same [-1.0, 1.0] to [0, 255] mapping as loadModel
+    vertex.nx = uint8_t((normal.x*0.5f+0.5f)*255.0f);
+    vertex.ny = uint8_t((normal.y*0.5f+0.5f)*255.0f);
+    vertex.nz = uint8_t((normal.z*0.5f+0.5f)*255.0f);
+    vertex.tx = floatToHalf(texCoords.x);
+    vertex.ty = floatToHalf(texCoords.y);
+    return vertex;
+}
+void generateSphere(Mesh& mesh, uint32_t frequency) {
+    const uint32_t n = std::max(1u, frequency);
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    const glm::vec3 corners[12] = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1},
+    };
+    const uint32_t faces[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1},
+    };
+
+    // vertices are shared between faces: first the 12 corners, then n-1 per edge, then the inside of every face
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edges;
+    for (const auto& face: faces) {
+        for (int k=0; k<3; k++) {
+            uint32_t a = face[k], b = face[(k+1)%3];
+            edges.emplace(std::make_pair(std::min(a, b), std::max(a, b)), edges.size());
+        }
+    }
+    const uint32_t edgeBase = 12;
+    const uint32_t faceBase = edgeBase + edges.size()*(n-1);
+    const uint32_t insidePerFace = n >= 2 ? (n-1)*(n-2)/2 : 0;
+    mesh.vertices.resize(faceBase + 20*insidePerFace);
+    mesh.indices.clear();
+    mesh.indices.reserve(size_t(20)*n*n*3);
+
+    auto setVertex = [&](uint32_t id, glm::vec3 position) {
+        glm::vec3 p = glm::normalize(position);
+        // longitude/latitude mapping, the seam is left as it is
+        glm::vec2 uv(std::atan2(p.y, p.x) / (2.0f*3.14159265f) + 0.5f, std::acos(glm::clamp(p.z, -1.0f, 1.0f)) / 3.14159265f);
+        mesh.vertices[id] = makeVertex(p, p, uv);
+    };
+    // point i steps towards b and j steps towards c from corner a of the face
+    auto vertexId = [&](uint32_t f, uint32_t i, uint32_t j) -> uint32_t {
+        uint32_t a = faces[f][0], b = faces[f][1], c = faces[f][2];
+        auto edgeVertex = [&](uint32_t from, uint32_t to, uint32_t step) {
+            uint32_t edge = edges[std::make_pair(std::min(from, to), std::max(from, to))];
+            return edgeBase + edge*(n-1) + (from < to ? step : n-step) - 1;
+        };
+        if (i == 0 && j == 0) return a;
+        if (i == n) return b;
+        if (j == n) return c;
+        if (j == 0) return edgeVertex(a, b, i);
+        if (i == 0) return edgeVertex(a, c, j);
+        if (i + j == n) return edgeVertex(b, c, j);
+        // rows j = 1..n-2 hold n-1-j inside points each
+        uint32_t row = j - 1;
+        uint32_t before = row*(n-2) - row*(row-1)/2;
+        return faceBase + f*insidePerFace + before + (i - 1);
+    };
+
+    for (uint32_t f=0; f<20; f++) {
+        glm::vec3 a = corners[faces[f][0]], b = corners[faces[f][1]], c = corners[faces[f][2]];
+        for (uint32_t j=0; j<=n; j++) {
+            for (uint32_t i=0; i+j<=n; i++) {
+                setVertex(vertexId(f, i, j), a + (b - a)*(float(i)/n) + (c - a)*(float(j)/n));
+            }
+        }
+        for (uint32_t j=0; j<n; j++) {
+            for (uint32_t i=0; i+j<n; i++) {
+                uint32_t v0 = vertexId(f, i, j), v1 = vertexId(f, i+1, j), v2 = vertexId(f, i, j+1);
+                mesh.indices.insert(mesh.indices.end(), {v0, v1, v2});
+                if (i + j + 1 < n) {
+                    uint32_t v3 = vertexId(f, i+1, j+1);
+                    mesh.indices.insert(mesh.indices.end(), {v1, v3, v2});
+                }
+            }
+        }
+    }
+}
+
+// smooth noise in [0, 1] made of random values on an integer lattice, interpolated in between
+static float valueNoise(float x, float y, uint32_t seed) {
+    auto lattice = [seed](int32_t xi, int32_t yi) {
+        uint32_t h = uint32_t(xi) * 374761393u + uint32_t(yi) * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return float((h ^ (h >> 16)) & 0xFFFF) / 65535.0f;
+    };
+    int32_t xi = int32_t(std::floor(x)), yi = int32_t(std::floor(y));
+    float fx = x - xi, fy = y - yi;
+    fx = fx*fx*(3.0f - 2.0f*fx);
+    fy = fy*fy*(3.0f - 2.0f*fy);
+    float top = lattice(xi, yi) + (lattice(xi+1, yi) - lattice(xi, yi))*fx;
+    float bottom = lattice(xi, yi+1) + (lattice(xi+1, yi+1) - lattice(xi, yi+1))*fx;
+    return top + (bottom - top)*fy;
+}
+void generateTerrain(Mesh& mesh, uint32_t quadsPerSide, float amplitude, uint32_t seed) {
+    const uint32_t q = std::max(1u, quadsPerSide);
+    const uint32_t verticesPerSide = q + 1;
+    auto height = [&](float u, float v) {
+        // a few octaves of noise, the first one spans the whole terrain about four times
+        float h = 0.0f, scale = 4.0f, weight = 0.5f;
+        for (int octave=0; octave<5; octave++) {
+            h += (valueNoise(u*scale, v*scale, seed + octave) - 0.5f) * weight;
+            scale *= 2.0f;
+            weight *= 0.5f;
+        }
+        return h * amplitude * 2.0f;
+    };
+
+    mesh.vertices.resize(size_t(verticesPerSide) * verticesPerSide);
+    const float step = 1.0f / q;
+    for (uint32_t y=0; y<verticesPerSide; y++) {
+        for (uint32_t x=0; x<verticesPerSide; x++) {
+            float u = x * step, v = y * step;
+            glm::vec3 position(u*2.0f - 1.0f, v*2.0f - 1.0f, height(u, v));
+            // central differences of the height field
+            float dx = (height(u + step, v) - height(u - step, v)) / (4.0f*step);
+            float dy = (height(u, v + step) - height(u, v - step)) / (4.0f*step);
+            glm::vec3 normal = glm::normalize(glm::vec3(-dx, -dy, 1.0f));
+            mesh.vertices[size_t(y)*verticesPerSide + x] = makeVertex(position, normal, glm::vec2(u, v));
+        }
+    }
+
+    mesh.indices.resize(size_t(q) * q * 6);
+    size_t i = 0;
+    for (uint32_t y=0; y<q; y++) {
+        for (uint32_t x=0; x<q; x++) {
+            uint32_t v0 = y*verticesPerSide + x;
+            uint32_t v1 = v0 + 1;
+            uint32_t v2 = v0 + verticesPerSide;
+            uint32_t v3 = v2 + 1;
+            uint32_t quad[] = {v0, v1, v3, v0, v3, v2};
+            for (uint32_t index: quad) mesh.indices[i++] = index;
+        }
+    }
+}
+void generateScatter(Mesh& mesh, const Mesh& base, uint32_t copies, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    // keep the copies small enough that most of them don't overlap
+    float scale = 0.5f / std::cbrt(float(std::max(1u, copies)));
+
+    mesh.vertices.resize(base.vertices.size() * copies);
+    mesh.indices.resize(base.indices.size() * copies);
+    for (uint32_t c=0; c<copies; c++) {
+        glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        float angle = unit(rng) * 3.14159265f;
+        float size = scale * (0.5f + 0.5f*(unit(rng)*0.5f + 0.5f));
+        // rotation around axis by angle (Rodrigues)
+        float cosA = std::cos(angle), sinA = std::sin(angle);
+        auto rotate = [&](glm::vec3 v) {
+            return v*cosA + glm::cross(axis, v)*sinA + axis*glm::dot(axis, v)*(1.0f - cosA);
+        };
+
+        size_t vertexBase = c * base.vertices.size();
+        for (size_t v=0; v<base.vertices.size(); v++) {
+            const Vertex& src = base.vertices[v];
+            glm::vec3 normal(src.nx/255.0f*2.0f - 1.0f, src.ny/255.0f*2.0f - 1.0f, src.nz/255.0f*2.0f - 1.0f);
+            glm::vec3 position = offset + rotate(vertexPosition(src)) * size;
+            Vertex vertex = makeVertex(position, rotate(normal), glm::vec2(0.0f, 0.0f));
+            vertex.tx = src.tx;
+            vertex.ty = src.ty;
+            mesh.vertices[vertexBase + v] = vertex;
+        }
+        size_t indexBase = c * base.indices.size();
+        for (size_t i=0; i<base.indices.size(); i++) {
+            mesh.indices[indexBase + i] = vertexBase + base.indices[i];
+        }
+    }
+}
+void generateInstances(std::vector<Instance>& instances, uint32_t count, uint32_t seed) {
+    instances.assign(std::max(1u, count), Instance{glm::vec3(0.0f), 1.0f, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)});
+    if (count <= 1) return;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    uint32_t side = std::ceil(std::sqrt(double(count)));
+    float spacing = 3.0f; // meshes fit into [-1, 1]^3, so neighbours never touch
+    for (uint32_t i=0; i<count; i++) {
+        Instance& instance = instances[i];
+        instance.position = glm::vec3((i % side - (side - 1)*0.5f) * spacing, (i / side - (side - 1)*0.5f) * spacing, 0.0f);
+        instance.scale = 1.0f + 0.25f*unit(rng);
+        float angle = unit(rng) * 3.14159265f;
+        instance.orientation = glm::vec4(0.0f, 0.0f, std::sin(angle*0.5f), std::cos(angle*0.5f));
+    }
+}
+bool generateSyntheticMesh(Mesh& mesh, const std::string& kind, uint64_t triangles, uint32_t seed) {
+    triangles = std::max<uint64_t>(triangles, 20);
+    mesh = Mesh{};
+    if (kind == "sphere") {
+        generateSphere(mesh, std::max(1.0, std::round(std::sqrt(triangles / 20.0))));
+    } else if (kind == "terrain") {
+        generateTerrain(mesh, std::max(1.0, std::round(std::sqrt(triangles / 2.0))), 0.15f, seed);
+    } else if (kind == "scatter") {
+        // small spheres of 320 triangles each, fewer triangles per copy if only a few are asked for
+        Mesh base;
+        generateSphere(base, std::min<uint64_t>(4, std::max(1.0, std::sqrt(triangles / 20.0))));
+        generateScatter(mesh, base, std::max<uint64_t>(1, triangles / (base.indices.size()/3)), seed);
+    } else {
+        return false;
+    }
+    return true;
+}
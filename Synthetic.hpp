@@ -0,0 +1,20 @@
+#pragma once
+#include "config.hpp"
+
+// procedural meshes of a controlled size, so every stage can be measured at scale without large assets
+// all of them fit roughly into [-1, 1]^3 with z up, like the viking room
+
+// geodesic sphere: every face of an icosahedron is split into frequency^2 triangles, 20*frequency^2 in total
+void generateSphere(Mesh& mesh, uint32_t frequency);
+// quadsPerSide^2 quads of a height field made of seeded value noise, 2*quadsPerSide^2 triangles
+void generateTerrain(Mesh& mesh, uint32_t quadsPerSide, float amplitude, uint32_t seed);
+// copies of base at random positions, rotations and scales, all in one mesh
+void generateScatter(Mesh& mesh, const Mesh& base, uint32_t copies, uint32_t seed);
+
+// count placements of one mesh on a square grid in the xy plane, 3 units apart, with random rotations
+// around z and scales, a single instance is the identity
+void generateInstances(std::vector<Instance>& instances, uint32_t count, uint32_t seed = 1);
+
+// picks the parameters of kind ("sphere", "terrain" or "scatter") so that the mesh has close to triangles triangles
+// returns false for an unknown kind
+bool generateSyntheticMesh(Mesh& mesh, const std::string& kind, uint64_t triangles, uint32_t seed = 1);
@@ -0,0 +1,261 @@
+#include "Meshlets.hpp"
+#include "Synthetic.hpp"
+#include "Assets.hpp"
+#include "DrawList.hpp"
+#include "Lod.hpp"
+#include "Lights.hpp"
+#include <thread>
+#include <functional>
+#include <random>
+
+// CPU only benchmarks of the asset ingest path, they never create a Vulkan device
+// usage: vkr-bench [--json] [--filter=substring] [--min-time=seconds] [--triangles=N] [--model=path] [--texture=path]
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;
+    double nsPerIteration = 0.0;
+    double itemsPerSecond = 0.0;
+    std::vector<std::pair<std::string, double>> counters; // extra numbers a benchmark wants to report
+};
+
+// keeps the compiler from dropping work whose result is otherwise unused
+static volatile uint64_t sink;
+
+// calls body once to warm up, then again until minSeconds have passed, body returns the number of items it processed
+static BenchmarkResult runBenchmark(const std::string& name, double minSeconds, const std::function<uint64_t()>& body) {
+    BenchmarkResult result;
+    result.name = name;
+    body();
+    uint64_t items = 0;
+    double elapsed = 0.0;
+    while (elapsed < minSeconds || result.iterations == 0) {
+        auto start = std::chrono::high_resolution_clock::now();
+        items += body();
+        auto end = std::chrono::high_resolution_clock::now();
+        elapsed += std::chrono::duration<double>(end - start).count();
+        result.iterations++;
+    }
+    result.nsPerIteration = elapsed * 1e9 / result.iterations;
+    result.itemsPerSecond = items / elapsed;
+    return result;
+}
+
+static void printText(const std::vector<BenchmarkResult>& results) {
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(14) << "ms/iter"
+        << std::setw(10) << "iters" << std::setw(16) << "items/s" << std::endl;
+    for (const auto& result: results) {
+        std::cout << std::left << std::setw(36) << result.name << std::right << std::fixed
+            << std::setw(14) << std::setprecision(3) << result.nsPerIteration * 1e-6
+            << std::setw(10) << result.iterations
+            << std::setw(16) << std::scientific << std::setprecision(3) << result.itemsPerSecond << std::fixed;
+        for (const auto& [key, value]: result.counters) std::cout << "  " << key << "=" << std::setprecision(2) << value;
+        std::cout << std::endl;
+    }
+}
+// same shape as google-benchmark's JSON reporter, so existing tooling can compare runs
+static void printJson(const std::vector<BenchmarkResult>& results) {
+    std::cout << "{\n  \"context\": {\"threads\": " << std::thread::hardware_concurrency() << "},\n  \"benchmarks\": [";
+    for (size_t i=0; i<results.size(); i++) {
+        const auto& result = results[i];
+        std::cout << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << std::setprecision(17) << ", \"real_time\": " << result.nsPerIteration << ", \"time_unit\": \"ns\""
+            << ", \"items_per_second\": " << result.itemsPerSecond;
+        for (const auto& [key, value]: result.counters) std::cout << ", \"" << key << "\": " << value;
+        std::cout << "}";
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
+
+static bool sameMeshlets(const Mesh& a, const Mesh& b) {
+    return a.meshlets.size() == b.meshlets.size() &&
+        memcmp(a.meshlets.data(), b.meshlets.data(), sizeof(Meshlet)*a.meshlets.size()) == 0 &&
+        a.meshletVertices == b.meshletVertices &&
+        a.meshletTriangles == b.meshletTriangles;
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    std::string filter;
+    double minTime = 0.5;
+    uint64_t triangles = 10000000;
+    std::string modelPath = "../viking_room.obj";
+    std::string texturePath = "../viking_room.png";
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix) { return arg.substr(strlen(prefix)); };
+        if (arg == "--json") json = true;
+        else if (arg.rfind("--filter=", 0) == 0) filter = value("--filter=");
+        else if (arg.rfind("--min-time=", 0) == 0) minTime = std::stod(value("--min-time="));
+        else if (arg.rfind("--triangles=", 0) == 0) triangles = std::stoull(value("--triangles="));
+        else if (arg.rfind("--model=", 0) == 0) modelPath = value("--model=");
+        else if (arg.rfind("--texture=", 0) == 0) texturePath = value("--texture=");
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BenchmarkResult> results;
+    auto run = [&](const std::string& name, const std::function<uint64_t()>& body) -> BenchmarkResult* {
+        if (name.find(filter) == std::string::npos) return nullptr;
+        if (!json) std::cerr << "running " << name << std::endl;
+        results.push_back(runBenchmark(name, minTime, body));
+        return &results.back();
+    };
+
+    // floats spread over the range positions and texture coordinates actually use
+    std::vector<float> floats(1 << 20);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> range(-4.0f, 4.0f);
+    for (float& f: floats) f = range(rng);
+    run("floatToHalf", [&]() -> uint64_t {
+        uint64_t sum = 0;
+        for (float f: floats) sum += floatToHalf(f);
+        sink = sum;
+        return floats.size();
+    });
+
+    // the terrain, unwelded back into one vertex per corner like loadObj sees it
+    Mesh terrain;
+    generateSyntheticMesh(terrain, "terrain", std::min<uint64_t>(triangles, 1000000));
+    std::vector<Vertex> corners(terrain.indices.size());
+    for (size_t i=0; i<corners.size(); i++) corners[i] = terrain.vertices[terrain.indices[i]];
+    run("vertexHash", [&]() -> uint64_t {
+        uint64_t sum = 0;
+        std::hash<Vertex> hash;
+        for (const Vertex& vertex: corners) sum += hash(vertex);
+        sink = sum;
+        return corners.size();
+    });
+    run("weldVertices", [&]() -> uint64_t {
+        Mesh welded;
+        weldVertices(welded, corners);
+        sink = welded.vertices.size();
+        return corners.size();
+    });
+
+    // the welded terrain de-interleaved into the position and attribute streams the GPU reads
+    run("splitVertexStreams", [&]() -> uint64_t {
+        splitVertexStreams(terrain, 0, terrain.vertices.size());
+        sink = terrain.positions.size();
+        return terrain.vertices.size();
+    });
+
+    if (std::ifstream(modelPath).good()) {
+        run("loadObj", [&]() -> uint64_t {
+            Mesh model;
+            loadObj(model, modelPath);
+            sink = model.vertices.size();
+            return model.indices.size()/3;
+        });
+    } else if (!json) {
+        std::cerr << "skipping loadObj, " << modelPath << " not found" << std::endl;
+    }
+
+    // strong scaling of buildMeshlets: same mesh, growing number of threads, output must not depend on the count
+    Mesh mesh;
+    generateSyntheticMesh(mesh, "terrain", triangles);
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads=1; threads<maxThreads; threads*=2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    Mesh reference;
+    double serialTime = 0.0;
+    bool allIdentical = true;
+    for (uint32_t threads: threadCounts) {
+        BenchmarkResult* result = run("buildMeshlets/threads:" + std::to_string(threads), [&]() -> uint64_t {
+            buildMeshlets(mesh, threads);
+            return mesh.indices.size()/3;
+        });
+        if (!result) continue;
+        if (reference.meshlets.empty()) {
+            reference.meshlets = mesh.meshlets;
+            reference.meshletVertices = mesh.meshletVertices;
+            reference.meshletTriangles = mesh.meshletTriangles;
+            serialTime = threads == 1 ? result->nsPerIteration : 0.0;
+        }
+        bool identical = sameMeshlets(mesh, reference);
+        allIdentical = allIdentical && identical;
+        if (serialTime > 0.0) {
+            result->counters.push_back({"speedup", serialTime / result->nsPerIteration});
+            result->counters.push_back({"efficiency", serialTime / result->nsPerIteration / threads});
+        }
+        result->counters.push_back({"identical", identical ? 1.0 : 0.0});
+    }
+
+    // every level of detail of the terrain, items are the triangles of level 0
+    run("buildLodLevels", [&]() -> uint64_t {
+        std::vector<LodLevel> levels;
+        buildLodLevels(terrain, levels);
+        sink = levels.size();
+        return terrain.indices.size()/3;
+    });
+
+    // a frame's worth of draw packets for a large scene, a few meshes and depth buckets spread over the whole range
+    std::vector<DrawPacket> packets(1 << 20);
+    std::vector<DrawPacket> sorted, scratch;
+    for (uint32_t i=0; i<packets.size(); i++) packets[i] = {makeDrawKey(1, 0, rng() % 8, rng() & 0xFFFFFF), i};
+    run("sortDrawPackets", [&]() -> uint64_t {
+        sorted = packets;
+        sortDrawPackets(sorted, scratch);
+        sink = sorted[0].instance;
+        return packets.size();
+    });
+
+    // light count stress test of the clustered binning, over a grid of 1024 instances seen like the engine sees it,
+    // what a fragment pays is the lights of its cluster, which the capacity keeps bounded however many there are
+    uint32_t lightInstances = 1024;
+    float sceneScale = std::ceil(std::sqrt(float(lightInstances))) * 1.5f;
+    glm::mat4 modelView = glm::lookAt(glm::vec3(2.0f) * sceneScale, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f * sceneScale, 10.0f * sceneScale);
+    proj[1][1] *= -1;
+    for (uint32_t lightCount: {256u, 1024u, 4096u, 16384u}) {
+        std::vector<Light> lights;
+        generateLights(lights, lightCount, lightInstances);
+        std::vector<uint32_t> counts, indices;
+        size_t dropped = 0;
+        BenchmarkResult* result = run("binLights/lights:" + std::to_string(lightCount), [&]() -> uint64_t {
+            dropped = binLights(lights, modelView, proj, counts, indices);
+            return uint64_t(lights.size()) * LIGHT_CLUSTER_COUNT;
+        });
+        if (!result) continue;
+        uint64_t total = 0;
+        uint32_t occupied = 0, maxCount = 0;
+        for (uint32_t count: counts) {
+            total += std::min(count, LIGHT_CLUSTER_CAPACITY);
+            occupied += count > 0;
+            maxCount = std::max(maxCount, count);
+        }
+        result->counters.push_back({"lightsPerCluster", occupied ? double(total) / occupied : 0.0});
+        result->counters.push_back({"maxLightsPerCluster", double(maxCount)});
+        result->counters.push_back({"dropped", double(dropped)});
+    }
+
+    int texWidth = 0, texHeight = 0, texChannels = 0;
+    stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    std::vector<uint8_t> texture;
+    if (pixels) {
+        texture.assign(pixels, pixels + size_t(texWidth)*texHeight*4);
+        stbi_image_free(pixels);
+    } else {
+        // no texture around, a noisy 2048x2048 one has the same cost
+        texWidth = texHeight = 2048;
+        texture.resize(size_t(texWidth)*texHeight*4);
+        for (uint8_t& texel: texture) texel = uint8_t(rng());
+    }
+    uint32_t mipLevels = std::floor(std::log2(std::max(texWidth, texHeight)))+1;
+    run("generateMipChain", [&]() -> uint64_t {
+        std::vector<uint8_t> chain = generateMipChain(texture.data(), texWidth, texHeight, mipLevels);
+        sink = chain.back();
+        return size_t(texWidth)*texHeight;
+    });
+
+    if (json) printJson(results);
+    else printText(results);
+    if (!allIdentical) {
+        std::cerr << "buildMeshlets output depends on the thread count" << std::endl;
+        return 1;
+    }
+    return 0;
+}
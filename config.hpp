@@ -65,6 +65,15 @@ struct Vertex {
         return attributes;
     }
 };
+// a Vertex de-interleaved into the two streams the GPU reads, position only passes (the depth prepass, culling,
+// the software rasterizer) fetch the 8 bytes of the position and nothing else
+struct VertexPosition {
+    uint16_t x, y, z, w;
+};
+struct VertexAttributes {
+    uint8_t nx, ny, nz, nw;
+    uint16_t tx, ty;
+};
 namespace std {
     template<> struct hash<Vertex> {
         size_t operator()(Vertex const& vertex) const {
@@ -77,23 +86,124 @@ namespace std {
 
 // this double indexing is more memory efficient compared to
 // simply storing 126*3 indices of size uint32_t
+// the meshlet itself is only a small header, its vertices and triangles live in two
+// packed streams shared by all meshlets, so it costs only as many bytes as it actually uses
 struct Meshlet {
-    uint32_t vertices[64];
-    uint8_t indices[126*3];
-    uint8_t triangleCount;
-    uint8_t vertexCount; 
+    uint32_t vertexBase; // smallest global vertex index of the meshlet, vertex deltas start from it
+    uint32_t vertexOffset; // first word of this meshlet in Mesh::meshletVertices
+    uint32_t triangleOffset; // first word of this meshlet in Mesh::meshletTriangles
+    uint8_t vertexCount; // max 64 unique vertices
+    uint8_t triangleCount; // max 126
+    uint8_t vertexBits; // width of one vertex delta, 8, 16 or 32 bits
+    uint8_t padding; // keeps the header at 16 bytes, same as std430 in the shader
+};
+
+// placement of one copy of the mesh, half the size of a matrix: position + rotate(orientation, scale * vertex)
+struct Instance {
+    glm::vec3 position;
+    float scale;
+    glm::vec4 orientation; // unit quaternion as (x, y, z, w)
+};
+
+// point light, or spot light when spotCosine is above -1, in the same space as the instances
+struct Light {
+    glm::vec3 position;
+    float radius; // no light reaches past it
+    glm::vec3 color;
+    float spotCosine; // cosine of the cone's half angle, -1 for a point light
+    glm::vec3 direction;
+    float padding;
+};
+
+// bounding sphere and normal cone of a meshlet, used to cull whole meshlets
+struct MeshletBounds {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis; // average direction the triangles are facing
+    float coneCutoff; // sine of the cone's half angle, 1 if the cone is too wide to ever cull
+};
+
+// the part of the meshlet arrays one chunk of MESHLET_CHUNK_TRIANGLES triangles was built into,
+// an edit rewrites meshlets inside it and only has to move later chunks when it doesn't fit anymore
+struct MeshletChunk {
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t vertexOffset; // first word in Mesh::meshletVertices
+    uint32_t vertexWords;
+    uint32_t triangleOffset; // first word in Mesh::meshletTriangles
+    uint32_t triangleWords;
 };
 
 struct Mesh {
     std::vector<Vertex> vertices;
+    // the vertices split into a position and an attribute stream, see splitVertexStreams
+    std::vector<VertexPosition> positions;
+    std::vector<VertexAttributes> attributes;
     std::vector<uint32_t> indices;
     std::vector<Meshlet> meshlets;
+    // sorted global vertex indices stored as deltas to the previous one, vertexBits wide each
+    std::vector<uint32_t> meshletVertices;
+    // 18 bits per triangle, 3 local indices of 6 bits each, so range is [0, 63]
+    std::vector<uint32_t> meshletTriangles;
+    std::vector<MeshletBounds> meshletBounds; // one per meshlet
+    std::vector<MeshletChunk> meshletChunks;
+};
+
+// where one mesh of the scene lives in the shared arrays (and buffers) of the geometry pool, in elements,
+// the instances drawing it are consecutive, uploaded as is as the mesh table
+struct MeshRange {
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// one level of detail of a mesh, the meshes' levels are uploaded as a table of LOD_MAX_LEVELS rows per mesh,
+// unused rows have no meshlets, lod.comp picks a level per instance and appends the instance to its level's draws
+struct MeshLod {
+    glm::vec3 center; // bounding sphere of the whole mesh, the same in every row of a mesh
+    float radius;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    float error; // farthest a vertex moved from level 0, in model units
+    uint32_t firstCommand; // the level's MeshTaskDraws, each one takes up to batchSize instances
+    uint32_t batchSize;
+    uint32_t instanceBase; // where the level's instances start in the instance order
+    uint32_t padding[2];
+};
+// one indirect mesh shader draw, shader.mesh finds its meshlets and instances through gl_DrawID
+struct MeshTaskDraw {
+    VkDrawMeshTasksIndirectCommandEXT command; // meshlets times instances workgroups
+    uint32_t meshletOffset;
+    uint32_t firstInstance;
+};
+
+// what the cull pass and the mesh shader count on the GPU every frame, meshlets are meshlet instances, the culled
+// ones by the first test they failed, triangles are the ones the culled draws of the vertex path and the mesh
+// shader emit
+struct PipelineCounters {
+    uint32_t meshletsTested;
+    uint32_t frustumCulled;
+    uint32_t coneCulled;
+    uint32_t occlusionCulled;
+    uint32_t trianglesEmitted;
+};
+
+// part of a bigger buffer, e.g. one of the sections of the meshlet buffer
+struct BufferRange {
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
 };
 
 struct QueueFamilies {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
     std::optional<uint32_t> transferFamily;
+    std::optional<uint32_t> computeFamily; // compute without graphics, for async compute, not every device has one
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value() && transferFamily.has_value();
     }
@@ -107,6 +217,65 @@ struct UniformBufferObject {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
+    glm::vec2 viewport; // rendered size in pixels, the light clusters' tiles are a fraction of it
+    uint32_t lightCount; // 0 leaves the surfaces unlit
+    uint32_t padding;
+};
+// push constants of cull.comp, the bounds stay in model space and are moved to view space there
+// see shader.mesh
+struct MeshConstants {
+    glm::vec2 sampleGrid; // framebuffer size times samples per axis, 0 when the sample locations aren't known
+    uint32_t cullTriangles;
+    uint32_t clusterList; // the workgroups read (meshlet, instance) from the hybrid rasterizer's list instead of the draws
+};
+struct CullConstants {
+    glm::mat4 modelView;
+    glm::vec4 frustum; // normals of the right and top planes of the symmetric frustum as (x, z, y, z)
+    glm::vec4 projection; // proj[0][0], proj[1][1], proj[2][2], proj[3][2]
+    float znear;
+    float zfar;
+    uint32_t drawCapacity; // meshlets times instances, summed over the meshes
+    uint32_t phase; // one of CullPhase
+    glm::vec2 pyramidSize;
+    glm::vec2 viewportScale; // of the render extent to the depth buffer's size, the part of the pyramid that was drawn
+    uint32_t meshCount;
+};
+// push constants of the hybrid rasterizer, shared by rasterclassify.comp, swraster.comp and swresolve.comp
+struct RasterConstants {
+    glm::vec2 viewport;
+    float threshold; // pixels per triangle, meshlets below it are rasterized in compute
+    uint32_t clusterCapacity; // meshlets times instances, summed over the meshes
+    uint32_t softwareCapacity; // most clusters one dispatch of swraster.comp can take
+    uint32_t meshCount;
+};
+// push constants of lod.comp
+struct LodConstants {
+    float threshold; // pixels a level may be off by on screen
+    float viewportHeight;
+    uint32_t instanceCount;
+    uint32_t meshCount;
+};
+// push constants of taa.comp
+struct TaaConstants {
+    glm::mat4 reprojection; // this frame's clip space without the jitter to the last frame's
+    glm::vec2 jitter; // in render pixels, sample i of the scene image lies at i + 0.5 - jitter
+    glm::vec2 renderSize; // part of the scene image that was drawn
+    glm::vec2 outputSize;
+    float blend; // weight of the current frame at a sample right on the pixel center
+    uint32_t reset; // no history to blend with
+};
+// which meshlets a cull dispatch looks at, see cull.comp
+enum CullPhase : uint32_t {
+    CULL_ALL = 0,
+    CULL_EARLY = 1,
+    CULL_LATE = 2,
+};
+// what a forward pass over the scene draws, with the prepass the depth is laid down first and the shading pass
+// only runs the fragment shader where the depth is equal to it
+enum DepthPrepass : uint32_t {
+    PREPASS_NONE = 0,
+    PREPASS_DEPTH = 1,
+    PREPASS_SHADE = 2,
 };
 
 #define VK_CHECK(x) vk_check_result((x), #x, __FILE__, __LINE__)
@@ -145,6 +314,9 @@ inline void vk_check_result(VkResult result, const char* expr, const char* file,
         throw std::runtime_error(oss.str());
     }
 }
+inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
 static std::vector<char> readFile(std::string filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary); // start reading at the end, read file as binary
     size_t fileSize = (size_t)file.tellg();
@@ -170,4 +342,17 @@ inline uint16_t floatToHalf(float f) {
     if (exp >= 31) return sign | 0x7C00; // Overflow/infinity
     
     return sign | (exp << 10) | (mantissa >> 13);
+}
+inline float halfToFloat(uint16_t h) {
+    union { uint32_t i; float f; } u;
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    if (exp == 0) u.i = sign; // floatToHalf never produces denormals
+    else if (exp == 31) u.i = sign | 0x7F800000 | (mantissa << 13); // infinity/NaN
+    else u.i = sign | ((exp - 15 + 127) << 23) | (mantissa << 13);
+    return u.f;
+}
+inline glm::vec3 vertexPosition(const Vertex& vertex) {
+    return glm::vec3(halfToFloat(vertex.x), halfToFloat(vertex.y), halfToFloat(vertex.z));
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+// the depth buffer read one sample at a time, include after defining DEPTH_BINDING
+// the passes resolve and read it as multisampled, with --msaa=1 there is nothing to resolve and the shaders are
+// built again with SINGLE_SAMPLE, a 1x image can't be bound to a sampler2DMS
+#ifdef SINGLE_SAMPLE
+layout(set = 0, binding = DEPTH_BINDING) uniform sampler2D depth;
+
+ivec2 depthSize() {
+    return textureSize(depth, 0);
+}
+int depthSamples() {
+    return 1;
+}
+float loadDepth(ivec2 pos, int s) {
+    return texelFetch(depth, pos, 0).r;
+}
+#else
+layout(set = 0, binding = DEPTH_BINDING) uniform sampler2DMS depth;
+
+ivec2 depthSize() {
+    return textureSize(depth);
+}
+int depthSamples() {
+    return textureSamples(depth);
+}
+float loadDepth(ivec2 pos, int s) {
+    return texelFetch(depth, pos, s).r;
+}
+#endif
@@ -0,0 +1,35 @@
+#version 460
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#include "mesh.h"
+
+// the depth prepass, only positions are read and nothing but depth comes out, the shading pass then tests for
+// equal depth, so the position has to come out bit for bit the same as in shader.vert
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(set = 1, binding = 0) readonly buffer Positions {
+    VertexPosition positions[];
+};
+layout(set = 1, binding = 2) readonly buffer Instances {
+    Instance instances[];
+};
+layout(set = 1, binding = 3) readonly buffer InstanceOrder {
+    uint instanceOrder[];
+};
+
+invariant gl_Position;
+
+void main() {
+    VertexPosition p = positions[gl_VertexIndex];
+    vec3 inPosition = vec3(p.vx, p.vy, p.vz);
+    Instance instance = instances[instanceOrder[gl_InstanceIndex]];
+    vec3 worldPosition = transformInstance(instance, inPosition);
+    vec4 viewPosition = ubo.view * ubo.model * vec4(worldPosition, 1.0);
+    gl_Position = ubo.proj * viewPosition;
+}
@@ -0,0 +1,44 @@
+// clustered forward lighting, include after declaring ubo and the Lights and LightGrid buffers
+// lightcull.comp lists the lights reaching each cluster and a fragment only walks the list of its own,
+// so its cost is bounded by the capacity no matter how many lights there are
+
+// near and far plane of ubo.proj, a perspective projection with depth in [0, 1]
+vec2 clusterDepthRange() {
+    return vec2(ubo.proj[3][2] / ubo.proj[2][2], ubo.proj[3][2] / (ubo.proj[2][2] + 1.0));
+}
+// distance from the camera where slice starts, slice LIGHT_CLUSTERS_Z is the far plane
+float clusterSliceDepth(uint slice, vec2 range) {
+    return range.x * pow(range.y / range.x, float(slice) / float(LIGHT_CLUSTERS_Z));
+}
+// cluster of a pixel, depth is the distance from the camera along the view direction
+uint clusterIndex(vec2 fragCoord, float depth) {
+    vec2 range = clusterDepthRange();
+    uvec2 tile = min(uvec2(fragCoord / ubo.viewport * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y)),
+        uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+    float slice = log(max(depth, range.x) / range.x) / log(range.y / range.x) * float(LIGHT_CLUSTERS_Z);
+    uint z = min(uint(slice), LIGHT_CLUSTERS_Z - 1);
+    return (z * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x;
+}
+
+// diffuse light reaching a surface in view space from the lights of its cluster, the falloff is inverse square
+// windowed to reach 0 at the light's radius
+vec3 shadeLights(vec2 fragCoord, vec3 position, vec3 normal) {
+    mat4 modelView = ubo.view * ubo.model;
+    uint cluster = clusterIndex(fragCoord, -position.z);
+    uint count = min(lightCounts[cluster], LIGHT_CLUSTER_CAPACITY);
+    vec3 color = vec3(0.0);
+    for (uint k=0; k<count; k++) {
+        Light light = lights[lightIndices[cluster * LIGHT_CLUSTER_CAPACITY + k]];
+        vec3 toLight = (modelView * vec4(light.position, 1.0)).xyz - position;
+        float distance = length(toLight);
+        vec3 l = toLight / max(distance, 1e-4);
+        float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        if (light.spotCosine > -1.0) {
+            float cosine = dot(-l, normalize(mat3(modelView) * light.direction));
+            attenuation *= smoothstep(light.spotCosine, mix(light.spotCosine, 1.0, 0.2), cosine);
+        }
+        color += light.color * attenuation * max(dot(normal, l), 0.0);
+    }
+    return color;
+}
@@ -1,6 +1,118 @@
 #include "Engine.hpp"
-int main() {
-    Engine engine;
+#include <cerrno>
+#include <cstdlib>
+// a count with an optional K or M suffix, e.g. 10M, false if the value isn't one or it is above max
+static bool parseCount(const std::string& value, uint64_t max, uint64_t& count) {
+    if (value.empty() || value[0] < '0' || value[0] > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    count = std::strtoull(value.c_str(), &end, 10);
+    uint64_t scale = 1;
+    if (*end == 'K' || *end == 'k') scale = 1000;
+    if (*end == 'M' || *end == 'm') scale = 1000000;
+    if (scale > 1) end++;
+    if (errno == ERANGE || *end != 0 || count > max / scale) return false;
+    count *= scale;
+    return true;
+}
+// a decimal number, false if the value isn't one or it is outside [min, max]
+static bool parseNumber(const std::string& value, float min, float max, float& number) {
+    if (value.empty()) return false;
+    char* end = nullptr;
+    errno = 0;
+    number = std::strtof(value.c_str(), &end);
+    return errno != ERANGE && end != value.c_str() && *end == 0 && number >= min && number <= max;
+}
+int main(int argc, char** argv) {
+    EngineOptions options;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        auto invalid = [&](const char* what) {
+            std::cerr << "Invalid " << what << ": " << arg << std::endl;
+            return 1;
+        };
+        uint64_t count = 0;
+        if (arg == "--meshlet-report") {
+            options.meshletReport = true;
+        } else if (arg == "--meshlet-report=json") {
+            options.meshletReport = true;
+            options.meshletReportJson = true;
+        } else if (arg == "--gpu-meshlets") {
+            options.gpuMeshlets = true;
+        } else if (arg == "--meshlet-indices") {
+            options.meshletIndices = true;
+        } else if (arg.rfind("--synthetic=", 0) == 0) {
+            // --synthetic=kind:triangles, e.g. --synthetic=terrain:10M
+            std::string value = arg.substr(12);
+            size_t colon = value.find(':');
+            options.syntheticKind = value.substr(0, colon);
+            options.syntheticTriangles = 1000000;
+            if (colon != std::string::npos) {
+                if (!parseCount(value.substr(colon + 1), UINT32_MAX, options.syntheticTriangles)) return invalid("count");
+            }
+        } else if (arg.rfind("--mesh=", 0) == 0) {
+            // --mesh=path.obj or --mesh=kind:triangles adds another mesh to the scene, may be repeated
+            std::string value = arg.substr(7);
+            size_t colon = value.find(':');
+            EngineOptions::MeshSource source;
+            if (colon != std::string::npos && value.find(".obj") == std::string::npos) {
+                source.syntheticKind = value.substr(0, colon);
+                if (!parseCount(value.substr(colon + 1), UINT32_MAX, source.syntheticTriangles)) return invalid("count");
+            } else {
+                source.path = value;
+            }
+            options.meshes.push_back(source);
+        } else if (arg.rfind("--instances=", 0) == 0) {
+            // --instances=N draws N copies of the mesh, e.g. --instances=100K
+            if (!parseCount(arg.substr(12), UINT32_MAX, count)) return invalid("count");
+            options.instances = std::max<uint64_t>(1, count);
+        } else if (arg.rfind("--lights=", 0) == 0) {
+            // --lights=N lights the scene with N point and spot lights, e.g. --lights=4K
+            if (!parseCount(arg.substr(9), UINT32_MAX, count)) return invalid("count");
+            options.lights = count;
+        } else if (arg == "--lod" || arg.rfind("--lod=", 0) == 0) {
+            // --lod=pixels builds levels of detail and lets each instance use the coarsest one whose error stays
+            // below that many pixels on screen, 1 without a value
+            options.lod = true;
+            float maxThreshold = std::numeric_limits<float>::max();
+            if (arg.size() > 5 && !parseNumber(arg.substr(6), 0.0f, maxThreshold, options.lodThreshold)) {
+                return invalid("pixel error");
+            }
+        } else if (arg == "--depth-prepass") {
+            // draws depth from the position stream first and shades only the visible fragments, P toggles it
+            options.depthPrepass = true;
+        } else if (arg == "--no-async-compute") {
+            // keeps the light binning on the graphics queue, A toggles it at runtime
+            options.asyncCompute = false;
+        } else if (arg.rfind("--frame-budget=", 0) == 0) {
+            // --frame-budget=ms scales the render resolution to keep the GPU time of a frame within it, e.g. 8.3,
+            // R toggles it at runtime
+            if (!parseNumber(arg.substr(15), 0.1f, 1000.0f, options.frameBudget)) return invalid("frame budget");
+        } else if (arg.rfind("--render-scale=", 0) == 0) {
+            // --render-scale=s renders at s times the window's resolution per axis when there is no frame budget
+            if (!parseNumber(arg.substr(15), 0.25f, 1.0f, options.renderScale)) return invalid("render scale");
+        } else if (arg == "--taa") {
+            // accumulates jittered frames into a full resolution history, with a single sample unless --msaa says
+            // otherwise, U toggles it at runtime
+            options.taa = true;
+        } else if (arg.rfind("--msaa=", 0) == 0) {
+            // --msaa=N uses at most N samples per pixel, 1 draws without multisampling
+            if (!parseCount(arg.substr(7), 64, count) || count == 0) return invalid("sample count");
+            options.msaaSamples = count;
+        } else if (arg == "--sw-raster" || arg.rfind("--sw-raster=", 0) == 0) {
+            // --sw-raster=pixels rasterizes visibility buffer meshlets whose triangles cover fewer pixels in compute,
+            // 1 without a value, [ and ] halve and double it at runtime
+            options.swRasterThreshold = 1.0f;
+            float maxThreshold = std::numeric_limits<float>::max();
+            if (arg.size() > 11 && !parseNumber(arg.substr(12), 0.0f, maxThreshold, options.swRasterThreshold)) {
+                return invalid("pixel count");
+            }
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    Engine engine(options);
     engine.run();
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,93 @@
-struct Vertex {
+// a vertex is split into two streams, passes that only need positions never touch the attributes
+struct VertexPosition {
 	float16_t vx, vy, vz, vw; // vw is only for alignment
+};
+struct VertexAttributes {
 	uint8_t nx, ny, nz, nw; // nw is only for alignment
 	float16_t tu, tv;
 };
 
+// same layout as PipelineCounters on the CPU, what survives each stage of a frame
+struct PipelineCounters {
+    uint meshletsTested;
+    uint frustumCulled;
+    uint coneCulled;
+    uint occlusionCulled;
+    uint trianglesEmitted;
+};
+
 struct Meshlet {
-    // those point (index) to the actual global buffer, but they contain unique numbers
-    uint vertices[64];
-    // those point to the local vertex array above, so range is [0, 63] 
-    uint8_t indices[126*3]; // up to 126 triangles
-    uint8_t triangleCount; // max 126
+    uint vertexBase; // global index of local vertex 0, the rest are deltas to the previous vertex
+    // those point (index) to the packed word streams below, shared by all meshlets
+    uint vertexOffset; // vertexCount deltas, vertexBits wide each
+    uint triangleOffset; // triangleCount triangles, 18 bits each (3 local indices of 6 bits, range [0, 63])
     uint8_t vertexCount;  // max 64 unique vertices
-};
\ No newline at end of file
+    uint8_t triangleCount; // max 126
+    uint8_t vertexBits; // 8, 16 or 32
+    uint8_t padding;
+};
+
+// same layout as Instance on the CPU
+struct Instance {
+    vec3 position;
+    float scale;
+    vec4 orientation; // unit quaternion as (x, y, z, w)
+};
+
+// the light clusters, same as on the CPU: the view frustum cut into tiles on screen and exponential slices in depth
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+#define LIGHT_CLUSTER_CAPACITY 128
+
+// same layout as Light on the CPU
+struct Light {
+    vec3 position;
+    float radius;
+    vec3 color;
+    float spotCosine;
+    vec3 direction;
+    float padding;
+};
+
+vec3 rotateQuat(vec3 v, vec4 q) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+vec3 transformInstance(Instance instance, vec3 position) {
+    return instance.position + rotateQuat(position * instance.scale, instance.orientation);
+}
+
+// same layout as MeshRange on the CPU, one row of the mesh table
+struct MeshRange {
+    uint vertexOffset;
+    uint vertexCount;
+    uint indexOffset;
+    uint indexCount;
+    uint meshletOffset;
+    uint meshletCount;
+    uint firstInstance;
+    uint instanceCount;
+};
+
+// same layout as MeshletBounds on the CPU, two vec3 + float pairs pack into 32 bytes in std430
+struct MeshletBounds {
+    vec3 center;
+    float radius;
+    vec3 coneAxis;
+    float coneCutoff; // sine of the cone's half angle, 1 if the cone is too wide to ever cull
+};
+
+// same layout as MeshLod on the CPU, one row of the level of detail table
+struct MeshLod {
+    vec3 center;
+    float radius;
+    uint meshletOffset;
+    uint meshletCount;
+    float error;
+    uint firstCommand;
+    uint batchSize;
+    uint instanceBase;
+    uint padding0;
+    uint padding1;
+};
@@ -0,0 +1,21 @@
+// decoding of the meshlet streams, include after declaring the meshletVertices and meshletTriangles buffers
+
+uint loadVertexDelta(Meshlet meshlet, uint i) {
+    // deltas are 8, 16 or 32 bits wide, so they never cross a word
+    uint bits = uint(meshlet.vertexBits);
+    uint bit = i * bits;
+    uint word = meshletVertices[meshlet.vertexOffset + (bit >> 5)];
+    return bits == 32 ? word : (word >> (bit & 31)) & ((1u << bits) - 1u);
+}
+
+uvec3 loadTriangle(Meshlet meshlet, uint i) {
+    // 18 bit triangles can start in one word and end in the next one
+    uint bit = i * 18;
+    uint word = meshlet.triangleOffset + (bit >> 5);
+    uint shift = bit & 31;
+    uint packed = meshletTriangles[word] >> shift;
+    if (shift > 32 - 18) {
+        packed |= meshletTriangles[word + 1] << (32 - shift);
+    }
+    return uvec3(packed & 63u, (packed >> 6) & 63u, (packed >> 12) & 63u);
+}
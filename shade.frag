@@ -0,0 +1,112 @@
+#version 460
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#include "mesh.h"
+
+// shades every pixel once from the visibility buffer, so the cost doesn't depend on how often it was drawn over,
+// the triangle's attributes come back out of the meshlet streams and the vertex streams
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec2 viewport;
+    uint lightCount;
+} ubo;
+layout(set = 0, binding = 1) uniform sampler2D texSampler;
+layout(set = 0, binding = 2) readonly buffer Lights {
+    Light lights[];
+};
+layout(set = 0, binding = 3) readonly buffer LightGrid {
+    uint lightCounts[LIGHT_CLUSTER_COUNT];
+    uint lightIndices[];
+};
+
+layout(set = 1, binding = 0) readonly buffer Positions {
+    VertexPosition positions[];
+};
+layout(set = 1, binding = 1) readonly buffer Attributes {
+    VertexAttributes attributes[];
+};
+layout(set = 1, binding = 2) readonly buffer Instances {
+    Instance instances[];
+};
+layout(set = 1, binding = 3) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+layout(set = 1, binding = 4) readonly buffer MeshletVertices {
+    uint meshletVertices[];
+};
+layout(set = 1, binding = 5) readonly buffer MeshletTriangles {
+    uint meshletTriangles[];
+};
+layout(set = 1, binding = 6, rg32ui) uniform readonly uimage2D visibility;
+
+#include "meshlet.h"
+#include "light.h"
+
+layout(location = 0) out vec4 outColor;
+
+float cross2(vec2 a, vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+void main() {
+    uvec2 ids = imageLoad(visibility, ivec2(gl_FragCoord.xy)).xy;
+    if (ids.x == ~0u) {
+        outColor = vec4(0.0, 0.0, 0.0, 1.0); // nothing there, the clear color of the forward pass
+        return;
+    }
+    Meshlet meshlet = meshlets[ids.x >> 7];
+    uvec3 triangle = loadTriangle(meshlet, ids.x & 127u);
+    Instance instance = instances[ids.y];
+
+    // the global index of a vertex is the base plus the deltas up to it
+    uint last = max(triangle.x, max(triangle.y, triangle.z));
+    uvec3 corners = uvec3(0);
+    uint index = meshlet.vertexBase;
+    for (uint i=0; i<=last; i++) {
+        index += loadVertexDelta(meshlet, i);
+        if (i == triangle.x) corners.x = index;
+        if (i == triangle.y) corners.y = index;
+        if (i == triangle.z) corners.z = index;
+    }
+
+    vec4 clip[3];
+    vec3 views[3];
+    vec3 normals[3];
+    vec2 uvs[3];
+    for (uint k=0; k<3; k++) {
+        VertexPosition p = positions[corners[k]];
+        VertexAttributes a = attributes[corners[k]];
+        vec4 view = ubo.view * ubo.model * vec4(transformInstance(instance, vec3(p.vx, p.vy, p.vz)), 1.0);
+        clip[k] = ubo.proj * view;
+        views[k] = view.xyz;
+        normals[k] = vec3(a.nx, a.ny, a.nz) / 255.0 * 2.0 - 1.0;
+        uvs[k] = vec2(a.tu, a.tv);
+    }
+
+    // barycentrics of the pixel center on screen, then corrected for perspective like the rasterizer does,
+    // a triangle crossing the near plane is assumed not to cover the pixel with its clipped part
+    vec2 p = gl_FragCoord.xy / ubo.viewport * 2.0 - 1.0;
+    vec2 a = clip[0].xy / clip[0].w;
+    vec2 b = clip[1].xy / clip[1].w;
+    vec2 c = clip[2].xy / clip[2].w;
+    vec3 screen = vec3(cross2(b - p, c - p), cross2(c - p, a - p), cross2(a - p, b - p)) / cross2(b - a, c - a);
+    vec3 bary = screen / vec3(clip[0].w, clip[1].w, clip[2].w);
+    bary /= bary.x + bary.y + bary.z;
+
+    vec3 normal = normals[0] * bary.x + normals[1] * bary.y + normals[2] * bary.z;
+    vec2 texCoords = uvs[0] * bary.x + uvs[1] * bary.y + uvs[2] * bary.z;
+    outColor = vec4(normal, 1.0); // what the vertex path shows
+    // outColor = texture(texSampler, texCoords);
+    if (ubo.lightCount > 0) {
+        // lit the same way as shader.frag
+        vec3 position = views[0] * bary.x + views[1] * bary.y + views[2] * bary.z;
+        vec3 viewNormal = normalize(mat3(ubo.view * ubo.model) * rotateQuat(normal, instance.orientation));
+        vec3 light = vec3(0.03) + shadeLights(gl_FragCoord.xy, position, viewNormal);
+        vec3 color = vec3(0.8) * light;
+        outColor = vec4(color / (color + 1.0), 1.0);
+    }
+}
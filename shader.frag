@@ -1,12 +1,41 @@
 #version 460
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#include "mesh.h"
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexCoords;
+layout(location = 3) in vec3 fragViewPosition;
+layout(location = 4) in vec3 fragViewNormal;
 layout(location = 0) out vec4 outColor;
 
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec2 viewport;
+    uint lightCount;
+} ubo;
 layout(set = 0, binding = 1) uniform sampler2D texSampler;
+layout(set = 0, binding = 2) readonly buffer Lights {
+    Light lights[];
+};
+layout(set = 0, binding = 3) readonly buffer LightGrid {
+    uint lightCounts[LIGHT_CLUSTER_COUNT];
+    uint lightIndices[];
+};
+
+#include "light.h"
 
 void main() {
     outColor = vec4(fragNormal, 1.0);
     // outColor = texture(texSampler, fragTexCoords);
-}
\ No newline at end of file
+    if (ubo.lightCount > 0) {
+        // a grey surface under the lights of its cluster, tone mapped as they can add up to anything
+        vec3 light = vec3(0.03) + shadeLights(gl_FragCoord.xy, fragViewPosition, normalize(fragViewNormal));
+        vec3 color = vec3(0.8) * light;
+        outColor = vec4(color / (color + 1.0), 1.0);
+    }
+}
@@ -11,20 +11,42 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
-layout(set = 1, binding = 0) readonly buffer Vertices {
-    Vertex vertices[];
+layout(set = 1, binding = 0) readonly buffer Positions {
+    VertexPosition positions[];
+};
+layout(set = 1, binding = 1) readonly buffer Attributes {
+    VertexAttributes attributes[];
+};
+layout(set = 1, binding = 2) readonly buffer Instances {
+    Instance instances[];
+};
+// instances in draw order, gl_InstanceIndex is a slot in it
+layout(set = 1, binding = 3) readonly buffer InstanceOrder {
+    uint instanceOrder[];
 };
 
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec2 fragTexCoords;
+// view space, what the lights are evaluated in
+layout(location = 3) out vec3 fragViewPosition;
+layout(location = 4) out vec3 fragViewNormal;
+
+// the shading pass after a depth prepass tests for equal depth against depth.vert
+invariant gl_Position;
 
 void main() {
-    Vertex v = vertices[gl_VertexIndex];
-    vec3 inPosition = vec3(v.vx, v.vy, v.vz);
-    vec3 inNormal = vec3(v.nx, v.ny, v.nz) / 255.0 * 2.0 - 1.0; // convert it from [0, 255] to [-1.0f, 1.0f]
-    vec2 inTexCoords = vec2(v.tu, v.tv);
+    VertexPosition p = positions[gl_VertexIndex];
+    VertexAttributes a = attributes[gl_VertexIndex];
+    vec3 inPosition = vec3(p.vx, p.vy, p.vz);
+    vec3 inNormal = vec3(a.nx, a.ny, a.nz) / 255.0 * 2.0 - 1.0; // convert it from [0, 255] to [-1.0f, 1.0f]
+    vec2 inTexCoords = vec2(a.tu, a.tv);
 
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    Instance instance = instances[instanceOrder[gl_InstanceIndex]];
+    vec3 worldPosition = transformInstance(instance, inPosition);
+    vec4 viewPosition = ubo.view * ubo.model * vec4(worldPosition, 1.0);
+    gl_Position = ubo.proj * viewPosition;
     fragNormal = inNormal;
+    fragViewPosition = viewPosition.xyz;
+    fragViewNormal = mat3(ubo.view * ubo.model) * rotateQuat(inNormal, instance.orientation);
     fragTexCoords = inTexCoords;
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 460
+#extension GL_EXT_mesh_shader: require
+
+// the visibility buffer only keeps which triangle covers the pixel, shading happens once per pixel in shade.frag
+layout(location = 2) perprimitiveEXT flat in uvec2 visibilityIds;
+layout(location = 0) out uvec2 outIds;
+
+void main() {
+    outIds = visibilityIds;
+}